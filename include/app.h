@@ -7,38 +7,42 @@
 #include <exception>
 #include <string>
 #include <fstream>
-#include <map>
 #include <memory>
 
 #include "SDL3/SDL.h"
 
 #include "input.h"
 #include "multithreading.h"
+#include "scheduler.h"
 #include "camera.h"
 #include "vec3.h"
 #include "interval.h"
 #include "logger.h"
+#include "framebuffer.h"
 
 class App {
 private:
     std::atomic<bool> _quit_app{ false };
     std::atomic<bool> _done_rendering{ false };
-    std::atomic<bool> _img_saved{ false };
+    std::atomic<bool> _stop_refining{ false }; // no new progressive pass is started once set
+    bool _headless{ false };
+    SDL_PixelFormat _image_format{ SDL_PIXELFORMAT_RGBA32 }; // R, G, B, A bytes in memory, as the .png wants them
     init_params_t _init_pars;
     std::shared_ptr<Logger> _logger;
     SDL_Window* _window{ nullptr };
     SDL_Renderer* _renderer{ nullptr };
-    SDL_Surface* _image_surface{ nullptr };
+    SDL_Texture* _texture{ nullptr }; // streaming, updated tile by tile
     std::thread _worker;
-    std::map<uint32_t, std::vector<uint32_t>> _pixels_map;
-    ThreadSafeQueue<scanline_t> _queue;
+    AccumBuffer _accum;
+    Framebuffer _framebuffer;
+    std::vector<uint32_t> _dirty_tiles; // tiles published since the last frame
     Camera _cam;
     void _worker_task();
     void _init_sdl();
-    void _save_png();
+    bool _update_texture();
 
 public:
-    App();
+    App(bool headless = false);
     ~App();
 
     void run();
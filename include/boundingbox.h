@@ -5,7 +5,6 @@
 
 #include "interval.h"
 #include "ray.h"
-#include "hitrecord.h"
 
 class BoundingBox {
 private:
@@ -28,7 +27,7 @@ public:
     float volume() const { return _volume; }
     const std::array<Vec3f, 2>& bounds() const { return _bounds; }
 
-    bool hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const;
+    bool hit(const Ray& r_in, const Interval& ray_t, float& t_entry) const;
 }; // class BoundingBox
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#include "vec3.h"
+#include "ray.h"
+#include "interval.h"
+#include "boundingbox.h"
+#include "triangle.h"
+#include "triblock.h"
+#include "packet.h"
+#include "logger.h"
+
+typedef struct BVHNode {
+    float bmin[3];
+    float bmax[3];
+    uint32_t offset; // first primitive for leaves, right child for inner nodes (left child is the next node)
+    uint32_t count; // number of primitives in a leaf, 0 for inner nodes
+} bvh_node_t; // 32 bytes, two nodes per cache line
+
+class BVHTree {
+    /**
+     * @brief: bounding volume hierarchy over a generic set of primitive
+     * bounding boxes, built with the binned surface area heuristic and
+     * stored as a flat array of nodes in depth first order
+     */
+private:
+    static constexpr uint32_t _max_depth = 64;
+    static constexpr uint32_t _n_bins = 16;
+
+    std::vector<bvh_node_t> _nodes;
+    std::vector<uint32_t> _prim_idx; // leaves address contiguous ranges of this permutation
+    uint32_t _max_leaf_size;
+    uint32_t _n_leaves{};
+    uint32_t _depth{};
+
+    struct BuildPrim;
+    uint32_t _build(std::vector<BuildPrim>& prims, uint32_t begin, uint32_t end, uint32_t depth);
+    static bool _hit_node(const bvh_node_t& node, const Ray& r_in, float t_min, float t_max, float& t_entry);
+
+public:
+    BVHTree() = default;
+    BVHTree(const std::vector<BoundingBox>& prim_bounds, uint32_t max_leaf_size = 4);
+
+    const std::vector<bvh_node_t>& nodes() const { return _nodes; }
+    const std::vector<uint32_t>& prim_indices() const { return _prim_idx; }
+    uint32_t num_nodes() const { return _nodes.size(); }
+    uint32_t num_leaves() const { return _n_leaves; }
+    uint32_t depth() const { return _depth; }
+
+    template<typename HitLeaf>
+    bool traverse(const Ray& r_in, const Interval& ray_t, HitLeaf&& hit_leaf) const;
+    template<typename HitLeaf>
+    void traverse(const ray_packet_t& packet, HitLeaf&& hit_leaf) const;
+}; // class BVHTree
+
+class BVH {
+private:
+    BoundingBox _bbox; // bbox enclosing the whole hierarchy
+    std::vector<tri_block_t> _blocks; // leaves triangles packed for the simd kernel, each leaf starts a new block
+    std::vector<uint32_t> _leaf_blocks; // first block of the leaf, indexed by the leaf offset in the permutation
+    std::shared_ptr<Logger> _logger;
+    BVHTree _tree;
+
+public:
+    BVH() = default;
+    BVH(const BoundingBox& bbox, const std::vector<Triangle>& tris, std::shared_ptr<Logger> logger, uint32_t max_leaf_size = Simd::width);
+
+    const BoundingBox& bbox() const { return _bbox; }
+
+    bool hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const;
+    bool occluded(const Ray& r_in, const Interval& ray_t) const;
+}; // class BVH
+
+inline bool BVHTree::_hit_node(const bvh_node_t& node, const Ray& r_in, float t_min, float t_max, float& t_entry) {
+    /**
+     * @brief: slab test, t_entry is the ray parameter at which the
+     * ray enters the node clipped to [t_min, t_max]
+     */
+    const Vec3f& origin = r_in.origin();
+    const Vec3f& inv_dir = r_in.inv_dir();
+    for (uint32_t a = 0; a < 3; ++a) {
+        float t0 = (node.bmin[a] - origin[a]) * inv_dir[a];
+        float t1 = (node.bmax[a] - origin[a]) * inv_dir[a];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+    }
+
+    t_entry = t_min;
+
+    return t_min <= t_max;
+}
+
+template<typename HitLeaf>
+bool BVHTree::traverse(const Ray& r_in, const Interval& ray_t, HitLeaf&& hit_leaf) const {
+    /**
+     * @brief: visits the nodes hit by the ray front to back, the nearest
+     * child first, and skips every node that starts behind the closest
+     * hit found so far
+     * @param hit_leaf: callable as bool(uint32_t first, uint32_t count, float& closest),
+     * it must test the leaf primitives [first, first + count) of the permutation
+     * and shrink closest when it finds a nearer hit. Setting closest to -inf
+     * ends the traversal, as any hit queries do
+     */
+    float t_entry;
+    float closest{ ray_t.max() };
+    if (_nodes.empty() || !_hit_node(_nodes[0], r_in, ray_t.min(), closest, t_entry)) {
+        return false;
+    }
+
+    std::pair<uint32_t, float> stack[_max_depth]; // postponed far children with their entry point
+    uint32_t stack_size{ 0 };
+    uint32_t node_idx{ 0 };
+    bool hit{ false };
+    while (true) {
+        const bvh_node_t& node = _nodes[node_idx];
+        if (node.count > 0) {
+            hit |= hit_leaf(node.offset, node.count, closest);
+        } else {
+            uint32_t near_idx{ node_idx + 1 };
+            uint32_t far_idx{ node.offset };
+            float t_near, t_far;
+            bool hit_near = _hit_node(_nodes[near_idx], r_in, ray_t.min(), closest, t_near);
+            bool hit_far = _hit_node(_nodes[far_idx], r_in, ray_t.min(), closest, t_far);
+            if (hit_near && hit_far) {
+                if (t_far < t_near) {
+                    std::swap(near_idx, far_idx);
+                    std::swap(t_near, t_far);
+                }
+
+                stack[stack_size++] = { far_idx, t_far };
+                node_idx = near_idx;
+                continue;
+            } else if (hit_near || hit_far) {
+                node_idx = hit_near ? near_idx : far_idx;
+                continue;
+            }
+        }
+
+        // resume from the nearest postponed node still in front of the closest hit
+        while (stack_size > 0 && stack[stack_size - 1].second > closest) {
+            --stack_size;
+        }
+        if (stack_size == 0) {
+            break;
+        }
+
+        node_idx = stack[--stack_size].first;
+    }
+
+    return hit;
+}
+template<typename HitLeaf>
+void BVHTree::traverse(const ray_packet_t& packet, HitLeaf&& hit_leaf) const {
+    /**
+     * @brief: visits the nodes hit by at least one ray of the packet,
+     * the child nearest to the packet origin first
+     * @param hit_leaf: callable as void(uint32_t first, uint32_t count, uint64_t rays),
+     * it must test the leaf primitives [first, first + count) of the
+     * permutation against the packet rays in the rays bitmask, those
+     * overlapping the leaf, and shrink the t of the rays it hits
+     * @details: nodes are tested when popped, against the closest hits
+     * found by then
+     */
+    uint32_t stack[_max_depth + 1];
+    uint32_t stack_size{ 0 };
+    if (!_nodes.empty()) {
+        stack[stack_size++] = 0;
+    }
+
+    const uint64_t rays{ RayPackets::all_rays(packet) };
+    while (stack_size > 0) {
+        const bvh_node_t& node = _nodes[stack[--stack_size]];
+        Vec3f bmin{ node.bmin[0], node.bmin[1], node.bmin[2] };
+        Vec3f bmax{ node.bmax[0], node.bmax[1], node.bmax[2] };
+        uint64_t node_rays{ RayPackets::hit_box(packet, bmin, bmax, rays) };
+        if (node_rays == 0) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            hit_leaf(node.offset, node.count, node_rays);
+            continue;
+        }
+
+        uint32_t near_idx{ static_cast<uint32_t>(&node - _nodes.data()) + 1 };
+        uint32_t far_idx{ node.offset };
+        auto center_dist = [&](const bvh_node_t& n) {
+            Vec3f center{ 0.5f * (n.bmin[0] + n.bmax[0]), 0.5f * (n.bmin[1] + n.bmax[1]), 0.5f * (n.bmin[2] + n.bmax[2]) };
+            return (center - packet.origin).length_squared(); // of the first ray when they do not share it
+        };
+        if (center_dist(_nodes[far_idx]) < center_dist(_nodes[near_idx])) {
+            std::swap(near_idx, far_idx);
+        }
+
+        stack[stack_size++] = far_idx;
+        stack[stack_size++] = near_idx;
+    }
+}
+#endif
\ No newline at end of file
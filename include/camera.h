@@ -6,37 +6,55 @@
 #include "SDL3/SDL.h"
 
 #include "vec3.h"
+#include "sampler.h"
 #include "color.h"
 #include "ray.h"
 #include "mesh.h"
 #include "matrix.h"
 #include "input.h"
 #include "logger.h"
+#include "multithreading.h"
+#include "framebuffer.h"
+#include "tonemap.h"
+#include "light.h"
+#include "envmap.h"
+#include "wavefront.h"
+#include "packet.h"
 
 class Camera {
 private:
-    bool _gamma_corr = true;
+    static constexpr float _shadow_acne_offset = 0.001f;
+
     Vec3f _u, _v, _w; // orthonormal basis
     Vec3f _pixel_delta_u, _pixel_delta_v; // image plane span vectors
     Vec3f _pixel00_loc; // coordinate of top-left pixel 
     Vec3f _camera_center;
-    SDL_PixelFormat _pixel_format;
+    Tonemapper _tonemapper;
     init_params_t _init_pars;
     camera_angles_t _angles;
     std::vector<geometry_params_t> _geometries;
     std::shared_ptr<Logger> _logger;
-    uint32_t _samples_pp_sqrt; // sqrt of samples_per_pixel
-    float _samples_pp_sqrt_inv;
-    float _sampling_scale;
     MeshList _meshes;
+    std::shared_ptr<const EnvironmentMap> _environment; // replaces the background color when set
+    LightList _lights;
 
     void _move();
     void _rotate_frame();
-    Ray _get_ray(uint32_t i, uint32_t j, uint32_t si, uint32_t sj) const;
-    Vec3f _sample_square_stratified(uint32_t si, uint32_t sj) const;
-    Color _trace(const Ray& r, uint32_t depth) const;
-    void _write_color(Color& color, std::vector<uint32_t>& row_colors) const;
-    void _gamma_correction(Color& color) const; 
+    Vec3f _sample_pixel(uint32_t i, uint32_t j, Sampler& sampler) const;
+    Ray _get_ray(uint32_t i, uint32_t j, Sampler& sampler) const;
+    Color _trace(const Ray& r, uint32_t depth, Sampler& sampler, const intersection_t* primary = nullptr) const;
+    void _miss(const Ray& ray, path_state_t& path) const;
+    bool _scatter(
+        const Ray& ray, 
+        const intersection_t& isect, 
+        uint32_t bounce, 
+        Sampler& sampler, 
+        path_state_t& path, 
+        shadow_ray_t& shadow, 
+        Vec3f& next_dir) const;
+    void _run_wave(wavefront_buffers_t& wf) const;
+    bool _render_tile_wavefront(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const;
+    bool _render_tile_packets(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const;
     
 public:
     Camera() = default;
@@ -53,7 +71,8 @@ public:
     ~Camera() = default;
     
     void set_meshes();
-    void set_pixel_format(SDL_PixelFormat format) { _pixel_format = format; }
-    std::vector<uint32_t> render_row(uint32_t j);
+    void set_pixel_format(SDL_PixelFormat format) { _tonemapper = Tonemapper{ format, _init_pars.tonemap }; }
+    bool render_tile(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const;
+    void resolve_tile(const tile_t& tile, const AccumBuffer& accum, Framebuffer& framebuffer) const;
 }; // class Camera
 #endif
\ No newline at end of file
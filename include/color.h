@@ -14,4 +14,9 @@ inline float linear_to_gamma(float component) {
 
     return std::sqrt(component);
 }
+
+inline float luminance(const Color& c) {
+    // Rec. 709 weights of the linear RGB components
+    return 0.2126f * c.x() + 0.7152f * c.y() + 0.0722f * c.z();
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef ENVMAP_H
+#define ENVMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include "vec3.h"
+#include "color.h"
+#include "sampler.h"
+
+typedef struct EnvironmentSample {
+    Vec3f dir; // unit
+    Color radiance;
+    float pdf{}; // solid angle
+} env_sample_t; // direction drawn from the environment map
+
+class EnvironmentMap {
+    /**
+     * @brief: radiance arriving from infinitely far away, stored as an
+     * equirectangular HDR image with +y up, loaded from a .pfm or a
+     * Radiance .hdr file
+     * @details: texels are piecewise constant over the sphere, so the
+     * directions can be importance sampled exactly: an alias table over the
+     * texels, weighted by luminance times the solid angle of their row,
+     * picks a texel and a uniform point inside it picks the direction
+     */
+private:
+    uint32_t _width{};
+    uint32_t _height{};
+    std::vector<Color> _texels; // row major, top row first
+    AliasTable _table;
+
+    void _load_pfm(const std::string& path);
+    void _load_hdr(const std::string& path);
+    void _build_table();
+    uint32_t _texel(const Vec3f& dir, float& sin_theta) const;
+
+public:
+    EnvironmentMap() = default;
+    EnvironmentMap(const std::string& path);
+    EnvironmentMap(uint32_t width, uint32_t height, std::vector<Color> texels);
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+
+    Color eval(const Vec3f& dir) const;
+    float pdf(const Vec3f& dir) const;
+    env_sample_t sample(float u_texel, sample_2d_t u_point) const;
+}; // class EnvironmentMap
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "color.h"
+#include "multithreading.h"
+
+class AccumBuffer {
+    /**
+     * @brief: float RGB sums of the samples taken so far, one entry per
+     * image pixel, the displayed color is the sum over the pixel's own
+     * sample count
+     * @details: render threads add to it without locking since the
+     * tiles they work on never overlap. The sum of the squared luminances
+     * gives the variance the adaptive sampling stops on, the pixels still
+     * to sample are picked between passes when no thread is writing
+     */
+private:
+    uint32_t _width{};
+    uint32_t _height{};
+    std::vector<float> _rgb; // row major, 3 floats per pixel
+    std::vector<float> _lum_sq;
+    std::vector<uint32_t> _samples;
+    std::vector<uint8_t> _active; // pixels sampled by the next pass
+    std::vector<uint8_t> _next_active;
+    std::vector<float> _errors; // error of each pixel as of its last pass
+
+    size_t _idx(uint32_t i, uint32_t j) const { return static_cast<size_t>(j) * _width + i; }
+
+public:
+    AccumBuffer() = default;
+    AccumBuffer(uint32_t width, uint32_t height)
+    : _width(width), _height(height),
+      _rgb(3 * static_cast<size_t>(width) * height, 0.f),
+      _lum_sq(static_cast<size_t>(width) * height, 0.f),
+      _samples(static_cast<size_t>(width) * height, 0),
+      _active(static_cast<size_t>(width) * height, 1) {}
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+    uint32_t samples(uint32_t i, uint32_t j) const { return _samples[_idx(i, j)]; }
+
+    void add(uint32_t i, uint32_t j, const Color& c) {
+        size_t p = _idx(i, j);
+        float* px = &_rgb[3 * p];
+        px[0] += c.x();
+        px[1] += c.y();
+        px[2] += c.z();
+        float lum = luminance(c);
+        _lum_sq[p] += lum * lum;
+        ++_samples[p];
+    }
+
+    Color average(uint32_t i, uint32_t j) const {
+        size_t p = _idx(i, j);
+        if (_samples[p] == 0) {
+            return Color();
+        }
+
+        const float* px = &_rgb[3 * p];
+
+        return Color(px[0], px[1], px[2]) / static_cast<float>(_samples[p]);
+    }
+
+    bool active(uint32_t i, uint32_t j) const { return _active[_idx(i, j)]; }
+
+    float error(uint32_t i, uint32_t j) const;
+    uint32_t update_active(uint32_t max_samples, uint32_t min_samples, float threshold);
+    uint64_t total_samples() const;
+    bool complete(const tile_t& tile, uint32_t max_samples) const;
+}; // class AccumBuffer
+
+class Framebuffer {
+    /**
+     * @brief: packed display pixels of the whole image, preallocated once.
+     * Render threads resolve their tiles straight into it and publish them
+     * through one atomic flag per tile, the window texture is updated from
+     * it and the .png writer reads it in place
+     * @details: rows start on a cache line so that tiles of different
+     * threads only share lines on their left and right borders. A tile
+     * rewritten by a later pass may be shown half updated for one frame,
+     * the flag guarantees that its final state is shown. The thread that
+     * raises a flag also queues the tile index, so the display visits only
+     * the tiles that changed and the queue never holds a tile twice
+     */
+private:
+    struct AlignedFree {
+        void operator()(uint32_t* p) const { std::free(p); }
+    };
+
+    static constexpr uint32_t _line_px = 64 / sizeof(uint32_t); // pixels per cache line
+
+    uint32_t _width{};
+    uint32_t _height{};
+    uint32_t _pitch{}; // row stride in pixels
+    uint32_t _tile_size{ 1 };
+    uint32_t _tiles_x{};
+    std::unique_ptr<uint32_t[], AlignedFree> _pixels;
+    std::vector<std::atomic<uint8_t>> _dirty; // one per tile, in the scheduler's row major order
+    std::unique_ptr<MpscRingBuffer<uint32_t>> _published; // indices of the flagged tiles
+
+public:
+    Framebuffer() = default;
+    Framebuffer(uint32_t width, uint32_t height, uint32_t tile_size);
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+    uint32_t pitch() const { return _pitch; }
+    uint32_t* data() { return _pixels.get(); }
+    const uint32_t* data() const { return _pixels.get(); }
+    uint32_t* row(uint32_t j) { return _pixels.get() + static_cast<size_t>(j) * _pitch; }
+    const uint32_t* row(uint32_t j) const { return _pixels.get() + static_cast<size_t>(j) * _pitch; }
+    uint32_t num_tiles() const { return _dirty.size(); }
+    uint32_t tile_index(const tile_t& tile) const { return (tile.y0 / _tile_size) * _tiles_x + tile.x0 / _tile_size; }
+    tile_t tile(uint32_t tile_idx) const {
+        uint32_t x0 = (tile_idx % _tiles_x) * _tile_size;
+        uint32_t y0 = (tile_idx / _tiles_x) * _tile_size;
+
+        return tile_t{ x0, y0, std::min(x0 + _tile_size, _width), std::min(y0 + _tile_size, _height) };
+    }
+
+    void publish(const tile_t& tile) {
+        uint32_t idx = tile_index(tile);
+        if (_dirty[idx].exchange(1, std::memory_order_acq_rel) == 0) {
+            _published->push(uint32_t{ idx }); // never blocks, there is a slot per tile
+        }
+    }
+
+    template<typename OutputIt>
+    size_t take_dirty(OutputIt out, size_t max_tiles) {
+        /**
+         * @brief: pops the indices of the tiles published since the last
+         * call and clears their flags, display thread only
+         * @details: a flag cleared before the pixels are read lets a new
+         * publish queue the tile again, so no update is lost
+         */
+        uint32_t idx[64];
+        size_t total{ 0 };
+        while (total < max_tiles) {
+            size_t n = _published->try_pop_batch(idx, std::min<size_t>(64, max_tiles - total));
+            for (size_t k = 0; k < n; ++k) {
+                // acquire pairs with the release of the last publish of the tile
+                _dirty[idx[k]].exchange(0, std::memory_order_acquire);
+                *out++ = idx[k];
+            }
+            total += n;
+            if (n == 0) {
+                break;
+            }
+        }
+
+        return total;
+    }
+}; // class Framebuffer
+#endif
\ No newline at end of file
@@ -3,42 +3,59 @@
 
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 #include "vec3.h"
 #include "boundingbox.h"
 #include "triangle.h"
+#include "triblock.h"
+#include "packet.h"
 #include "logger.h"
 
-class Grid;
+typedef struct GridTraversal {
+    static constexpr uint32_t mailbox_size = 32; // power of two
 
-class Cell {
-private:
-    std::vector<Triangle> _triangles;
-
-public:
-    Cell() = default;
-    const std::vector<Triangle>& tris() { return _triangles; }
-
-    void push_triangle(const Triangle& tri) { _triangles.push_back(tri); }
+    int32_t cell_index[3]; // cell currently visited by the ray
+    float t_max[3]; // ray parameter at which the next cell boundary is crossed
+    float t_delta[3]; // ray parameter increment between two boundaries
+    int32_t step[3];
+    int32_t exit[3]; // cell index out of the grid
+    uint32_t mailbox[mailbox_size]; // direct mapped cache of the triangles already tested by the ray
+    tri_block_t block; // triangles of the current cell gathered for the simd kernel
+} grid_traversal_t; // per-ray dda state, lives on the tracing thread's stack
 
-    uint32_t num_tris() const { return _triangles.size(); }
+typedef struct GridPacketTraversal {
+    static constexpr uint32_t mailbox_size = 256; // power of two, a slice of cells is wider than the cells of a ray
 
-    bool hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec, Grid& g) const;
-}; // class Cell
+    uint32_t axis[3]; // main axis the packet walks along, then the two axes of the slices
+    float slope_min[2]; // frustum of the active rays, offsets on the slice axes per unit step on the main axis
+    float slope_max[2];
+    float inv_main_dir[ray_packet_t::max_size]; // 1 / |dir| on the main axis
+    uint32_t mailbox[mailbox_size]; // direct mapped cache of the triangles already tested by the packet
+} grid_packet_traversal_t; // per-packet state of the coherent traversal
 
 class Grid {
 private:
     BoundingBox _bbox; // bbox enclosing the grid
     std::vector<Triangle> _triangles;
     std::shared_ptr<Logger> _logger;
-    std::vector<Cell> _cells;
+    std::vector<uint32_t> _cell_offsets; // cell i lists _cell_tris[_cell_offsets[i], _cell_offsets[i + 1])
+    std::vector<uint32_t> _cell_tris; // triangle indices of all the cells, stored back to back
     Vec3f _cellsize;
     float _lambda; // hyperparameter that determines the grid resolution
     uint32_t _n[3]{}; // grid resolution in each dimension
-    int32_t _cell_index[3]; // used for dda traversal
 
+    void _cell_range(const Triangle& tri, uint32_t lo[3], uint32_t hi[3]) const;
     void _insert_triangles();
-    bool _dda(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec);
+    template<bool any_hit>
+    bool _hit_cell(uint32_t cell_idx, const simd_ray_t& ray, float t_min, grid_traversal_t& trav, intersection_t& closest) const;
+    void _init_traversal(const Ray& r_in, float t_entry, grid_traversal_t& trav) const;
+    template<bool any_hit>
+    bool _dda(const Ray& r_in, const Interval& ray_t, float t_entry, intersection_t& isect) const;
+    bool _init_packet_traversal(const ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const;
+    void _packet_frustum(const ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const;
+    uint64_t _hit_cell(uint32_t cell_idx, ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const;
+    uint64_t _hit_rays(ray_packet_t& packet, uint64_t active) const;
 
 public:
     Grid() = default;
@@ -47,8 +64,8 @@ public:
     const BoundingBox& bbox() const { return _bbox; }
     void set_bbox(const BoundingBox& bbox) { _bbox = bbox; } 
 
-    bool hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec);
-
-    friend Cell;
+    bool hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const;
+    bool occluded(const Ray& r_in, const Interval& ray_t) const;
+    uint64_t hit(ray_packet_t& packet) const;
 }; // class Grid
 #endif
\ No newline at end of file
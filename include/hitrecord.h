@@ -1,9 +1,19 @@
 #ifndef HITRECORD_H
 #define HITRECORD_H
 
+#include <cstdint>
+
 #include "vec3.h"
 #include "ray.h"
 #include "color.h"
+#include "interval.h"
+
+typedef struct Intersection {
+    float t{ inf };
+    float u{}, v{}; // baricentric coords
+    uint32_t prim{ UINT32_MAX }; // triangle index in the mesh
+    uint32_t instance{ UINT32_MAX }; // instance index in the MeshList
+} intersection_t; // closest hit candidate carried through the traversals, shaded only once found
 
 class HitRecord {
 private:
@@ -11,6 +21,7 @@ private:
     Vec3f _hitpt_normal;
     float _t;
     Color _color;
+    Color _emission;
     float _u, _v; // baricentric coords for ray-triangle intersection
 
 public:
@@ -22,11 +33,13 @@ public:
     const Vec3f& get_hit_point() const { return _hit_point; }
     const Vec3f& get_normal() const { return _hitpt_normal; }
     const Color& get_color() const { return _color; }
+    const Color& get_emission() const { return _emission; }
 
     void set_t(float t) { _t = t; }
     void set_hit_point(const Vec3f& p) { _hit_point = p; }
     void set_normal(const Vec3f& n) { _hitpt_normal = n; }
     void set_color(const Color& col) { _color = col; }
+    void set_emission(const Color& e) { _emission = e; }
     void set_u(float u) { _u = u; }
     void set_v(float v) { _v = v; } 
 }; // class HitRecord
@@ -11,18 +11,48 @@
 
 using njson = nlohmann::json;
 
+enum class SamplerType {
+    independent, // a fresh random stream per sample
+    sobol, // Owen scrambled Sobol points, decorrelated per pixel
+    blue_noise // Sobol points shared by all pixels, dithered by a blue noise mask
+};
+
+enum class TonemapType {
+    none, // radiance above 1 is clipped
+    reinhard, // c / (1 + c), never saturates
+    aces // Narkowicz fit of the ACES filmic curve, contrasty with soft highlights
+};
+
+enum class EngineType {
+    megakernel, // every sample is traced to the end before the next one starts
+    wavefront // the samples of a tile advance together one bounce at a time
+};
+
 typedef struct InitParams {
     uint32_t img_width;
     uint32_t img_height;
     uint32_t window_width;
     uint32_t window_height;
-    uint32_t depth;
+    uint32_t depth; // max bounces of a path
+    uint32_t rr_depth; // bounces before Russian roulette can end a path
     uint32_t samples_per_pixel;
+    uint32_t samples_per_pass; // progressive rendering, 0 takes every sample in a single pass
+    uint32_t min_samples_per_pixel; // adaptive sampling never stops a pixel before these
+    float adaptive_threshold; // stop sampling a pixel once its error is below, 0 disables adaptive sampling
+    uint32_t threads; // render threads, 0 means one per hardware thread
+    uint32_t tile_size; // side in pixels of the square tiles handed to the threads
+    bool headless; // no window, the image is only written to the .png
+    uint32_t max_fps; // cap on the window refresh rate while rendering, 0 presents as often as tiles finish
+    SamplerType sampler; // sequence the pixel and path samples are drawn from
+    TonemapType tonemap; // curve applied to the pixel radiance before gamma correction
+    EngineType engine; // how the paths of a tile are scheduled, both give the same image
+    uint32_t packet_size; // side of the pixel blocks whose camera rays are traced as a packet, 4 or 8, 0 disables packets
     float vfov; // vertical aperture
     float focus_dist; // distance from camera to image plane
     Vec3f lookfrom;
     Vec3f lookat;
     Color background;
+    std::string environment_map; // equirectangular .pfm or .hdr file in init/, replaces background when set
     std::string outfile_name;
 } init_params_t;
 
@@ -34,8 +64,14 @@ typedef struct CameraAngles {
     float phi{}; // moves camera on the XZ plane
 } camera_angles_t;
 
+enum class AccelType {
+    grid, // uniform grid, cheap to build, fits evenly tessellated meshes
+    bvh // SAH bounding volume hierarchy, robust to uneven triangle density
+};
+
 typedef struct GeometryParams {
     std::string obj_file;
+    AccelType accel{ AccelType::grid }; // per mesh acceleration structure
     float alpha{}; // rotates mesh around x
     float beta{}; // rotates mesh around y
     float gamma{}; // rotates mesh around z
@@ -47,6 +83,10 @@ void from_json(const njson& j, Vec3f& v);
 void from_json(const njson& j, init_params_t& p);
 void from_json(const njson& j, camera_angles_t& angles);
 void from_json(const njson& j, geometry_params_t& g);
+void from_json(const njson& j, AccelType& accel);
+void from_json(const njson& j, SamplerType& sampler);
+void from_json(const njson& j, TonemapType& tonemap);
+void from_json(const njson& j, EngineType& engine);
 void to_lower(std::string& str);
 void lowercase_keys(njson& j);
 void validate_keys(njson& j, std::set<std::string>&& allowed_keys);
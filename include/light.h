@@ -0,0 +1,74 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "vec3.h"
+#include "color.h"
+#include "hitrecord.h"
+#include "interval.h"
+#include "sampler.h"
+#include "mesh.h"
+#include "envmap.h"
+
+typedef struct LightSample {
+    Vec3f wi; // unit, from the shaded point to the light
+    float dist{ inf }; // to the light point, inf for the environment
+    Color emission;
+    float pdf{}; // solid angle density at the shaded point, 0 if it can not light it
+} light_sample_t; // point drawn on a light for next event estimation
+
+class LightList {
+    /**
+     * @brief: world space copies of the emissive triangles of the scene,
+     * picked for next event estimation with probability proportional to
+     * their power and then sampled uniformly by area, plus the
+     * environment map when there is one
+     * @details: emitters radiate from both sides, the same way triangles
+     * are intersected from both sides. With both kinds of light half of
+     * the samples go to the environment, their powers are not comparable
+     * since the environment power depends on the scene size
+     */
+private:
+    typedef struct EmissiveTriangle {
+        Vec3f v0;
+        Vec3f e1; // v1 - v0
+        Vec3f e2; // v2 - v0
+        Vec3f normal;
+        float area;
+        Color emission;
+    } emissive_triangle_t;
+
+    std::vector<emissive_triangle_t> _tris;
+    std::vector<uint32_t> _first_light; // of every instance, UINT32_MAX if it does not emit
+    AliasTable _table; // over the power of _tris
+    std::shared_ptr<const EnvironmentMap> _environment;
+    float _environment_prob{ 0.f }; // of sampling the environment instead of a triangle
+
+    float _solid_angle_pdf(uint32_t light, const Vec3f& p, const Vec3f& q) const;
+
+public:
+    LightList() = default;
+    LightList(const MeshList& meshes, std::shared_ptr<const EnvironmentMap> environment = nullptr);
+
+    bool empty() const { return _tris.empty() && !_environment; }
+    uint32_t size() const { return _tris.size(); }
+
+    light_sample_t sample(const Vec3f& p, float u_light, sample_2d_t u_point) const;
+    float pdf(const Vec3f& p, const intersection_t& isect, const Vec3f& q) const;
+    float environment_pdf(const Vec3f& dir) const { return _environment ? _environment_prob * _environment->pdf(dir) : 0.f; }
+}; // class LightList
+
+inline float power_heuristic(float pdf_a, float pdf_b) {
+    /**
+     * @brief: MIS weight of a sample drawn with pdf_a when the same
+     * point could also have been drawn with pdf_b (Veach, beta = 2)
+     */
+    float a2 = pdf_a * pdf_a;
+    float b2 = pdf_b * pdf_b;
+
+    return a2 > 0.f ? a2 / (a2 + b2) : 0.f;
+}
+#endif
\ No newline at end of file
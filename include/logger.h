@@ -4,6 +4,15 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <mutex>
+#include <memory>
+
+typedef struct alignas(64) RayCounters {
+    uint64_t rays{};
+    uint64_t total_ray_tri_intersections{};
+    uint64_t true_ray_tri_intersections{};
+    uint64_t avoided_ray_tri_intersections{}; // skipped by grid mailboxing
+} ray_counters_t; // one per render thread, cache line aligned to avoid false sharing
 
 class Logger {
 private:
@@ -11,24 +20,62 @@ private:
     std::string _log_file;
     std::string _outdir;
     uint32_t _mesh_objects{};
+    uint32_t _instances{};
     uint32_t _triangles{};
-    uint32_t _total_ray_tri_intersections{};
-    uint32_t _true_ray_tri_intersections{};
+    uint32_t _lights{}; // emissive triangles
+    uint32_t _render_threads{ 1 };
+    uint32_t _tiles{};
     float _render_time{};
-    std::vector<std::vector<uint32_t>> _grids; 
+    uint32_t _passes{ 1 };
+    float _first_pass_time{};
+    uint64_t _samples{}; // camera samples of the whole image
+    uint64_t _pixels{};
+    std::vector<std::vector<uint32_t>> _grids;
+    std::vector<std::vector<uint32_t>> _bvhs;
+    std::vector<uint32_t> _top_level; // nodes, leaves and depth of the BVH over the meshes
+    uint64_t _id; // distinguishes loggers in the thread local cache
+    std::mutex _counters_mut;
+    std::vector<std::unique_ptr<ray_counters_t>> _counters;
 
     void _print_log(std::ostream& out) const;
+    ray_counters_t& _register_thread();
+    ray_counters_t& _thread_counters();
 
 public:
     Logger(const std::string& outdir, const std::string& filename);
     void add_mesh_obj() { ++_mesh_objects; }
+    void add_instance() { ++_instances; }
     void add_tris(uint32_t tris) { _triangles += tris; }
+    void set_lights(uint32_t lights) { _lights = lights; }
     void add_grid_and_cells(uint32_t nx, uint32_t ny, uint32_t nz) { _grids.emplace_back(std::vector<uint32_t>{nx, ny, nz}); }
-    void add_ray_tri_int() { ++_total_ray_tri_intersections; }
-    void add_true_ray_tri_int() { ++_true_ray_tri_intersections; }
+    void add_bvh(uint32_t nodes, uint32_t leaves, uint32_t depth) { _bvhs.emplace_back(std::vector<uint32_t>{nodes, leaves, depth}); }
+    void set_top_level(uint32_t nodes, uint32_t leaves, uint32_t depth) { _top_level = {nodes, leaves, depth}; }
+    void add_ray() { ++_thread_counters().rays; }
+    void add_ray_tri_int(uint64_t n = 1) { _thread_counters().total_ray_tri_intersections += n; }
+    void add_true_ray_tri_int(uint64_t n = 1) { _thread_counters().true_ray_tri_intersections += n; }
+    void add_avoided_ray_tri_int() { ++_thread_counters().avoided_ray_tri_intersections; }
     void set_rendertime(float t) { _render_time = t; }
-    
+    void set_render_threads(uint32_t threads, uint32_t tiles) { _render_threads = threads; _tiles = tiles; }
+    void set_passes(uint32_t passes, float first_pass_time) { _passes = passes; _first_pass_time = first_pass_time; }
+    void set_samples(uint64_t samples, uint64_t pixels) { _samples = samples; _pixels = pixels; }
+
+    ray_counters_t counters() const;
     void log() const;
 }; // class Logger
 
+inline ray_counters_t& Logger::_thread_counters() {
+    /**
+     * @brief: ray counters are bumped from every render thread in the
+     * innermost loops, so each thread gets its own slot instead of
+     * sharing an atomic, slots are summed up only when logging
+     */
+    thread_local uint64_t owner{ 0 };
+    thread_local ray_counters_t* counters{ nullptr };
+    if (owner != _id) {
+        counters = &_register_thread();
+        owner = _id;
+    }
+
+    return *counters;
+}
 #endif
\ No newline at end of file
@@ -54,6 +54,51 @@ inline void mat4_vec3_prod_inplace(const Mat4& m, Vec3f& v) {
     v.set_z(z + m[3][2]);
 }
 
+inline Vec3f mat4_vec3_prod(const Mat4& m, const Vec3f& v) {
+    /**
+     * @brief: transforms the point v, translation included
+     */
+    Vec3f p{ v };
+    mat4_vec3_prod_inplace(m, p);
+
+    return p;
+}
+
+inline Vec3f mat4_dir_prod(const Mat4& m, const Vec3f& v) {
+    /**
+     * @brief: transforms the direction v, only the linear part of m applies
+     */
+    float x{};
+    float y{};
+    float z{};
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        x += v[i]*(m[0][i]);
+        y += v[i]*(m[1][i]);
+        z += v[i]*(m[2][i]);
+    }
+
+    return Vec3f(x,y,z);
+}
+
+inline Vec3f mat4_normal_prod(const Mat4& m_inv, const Vec3f& n) {
+    /**
+     * @brief: transforms the normal n with the transpose of the
+     * linear part of the inverse transformation m_inv
+     */
+    float x{};
+    float y{};
+    float z{};
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        x += n[i]*(m_inv[i][0]);
+        y += n[i]*(m_inv[i][1]);
+        z += n[i]*(m_inv[i][2]);
+    }
+
+    return Vec3f(x,y,z);
+}
+
 Mat3 rotation_3d(float t, const Vec3f& n);
 Mat3 frame_rotation(float a, float b, float c);
 Mat3 transpose(const Mat3& m);
@@ -8,6 +8,9 @@
 #pragma GCC diagnostic pop
 
 #include <memory>
+#include <variant>
+#include <map>
+#include <utility>
 
 #include "input.h"
 #include "color.h"
@@ -18,41 +21,89 @@
 #include "logger.h"
 #include "triangle.h"
 #include "grid.h"
-
-class MeshList;
+#include "bvh.h"
+#include "packet.h"
+#include "wavefront.h"
 
 class Mesh {
+    /**
+     * @brief: triangles of an objl::Mesh in object space, shared by
+     * every Instance placing the same OBJ file in the scene
+     */
 private:
     Color _color;
+    Color _emission; // Ke of the material, radiance leaving every triangle
     std::vector<Triangle> _triangles;
-    Mat4 _transf;
-    Mat4 _transf_inv;
-    mutable Grid _grid;
+    std::variant<Grid, BVH> _accel; // acceleration structure selected in the geometry file
 
 public:
     Mesh() = default;
-    Mesh(const objl::Mesh& mesh, Mat4&& m, Mat4&& m_inv, MeshList& list);
+    Mesh(const objl::Mesh& mesh, AccelType accel, std::shared_ptr<Logger> logger);
 
     const std::vector<Triangle>& get_triangles() const { return _triangles; }
-    Grid& grid() { return _grid; } 
+    const Color& emission() const { return _emission; }
+    bool emissive() const { return _emission.x() > 0.f || _emission.y() > 0.f || _emission.z() > 0.f; }
+    const BoundingBox& bbox() const;
+    const Grid* grid() const { return std::get_if<Grid>(&_accel); }
 
-    bool hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const;
+    bool hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const;
+    bool occluded(const Ray& r_in, const Interval& ray_t) const;
 }; // class Mesh
 
+class Instance {
+    /**
+     * @brief: placement of a shared Mesh in the scene, rays are moved
+     * to object space instead of baking the transformation in the triangles
+     */
+private:
+    std::shared_ptr<const Mesh> _mesh;
+    Mat4 _transf; // object to world
+    Mat4 _transf_inv; // world to object
+    BoundingBox _bbox; // world space
+
+public:
+    Instance() = default;
+    Instance(std::shared_ptr<const Mesh> mesh, Mat4&& m, Mat4&& m_inv);
+
+    const Mesh& mesh() const { return *_mesh; }
+    const Mat4& transformation() const { return _transf; }
+    const BoundingBox& bbox() const { return _bbox; }
+
+    bool hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const;
+    bool occluded(const Ray& r_in, const Interval& ray_t) const;
+    void hit(ray_packet_t& packet, uint32_t instance_idx, uint64_t rays) const;
+    HitRecord hit_record(const Ray& r_in, const intersection_t& isect) const;
+}; // class Instance
+
 class MeshList {
 private:
-    std::vector<Mesh> _meshes;
+    using prototype_key_t = std::pair<std::string, AccelType>;
+
+    std::map<prototype_key_t, std::vector<std::shared_ptr<const Mesh>>> _prototypes; // meshes of each OBJ file
+    std::vector<Instance> _instances; // in top level leaves order once built
     std::shared_ptr<Logger> _logger;
+    BVHTree _top_level; // over the instances bounding boxes
+    bool _grids_only{ false }; // every mesh is in a Grid, camera packets pay off
 
 public:
     MeshList() = default;
     
     void set_logger(std::shared_ptr<Logger> logger) { _logger = logger; }
 
-    void add(const objl::Loader& loader, const geometry_params_t& g);
+    bool has_prototype(const geometry_params_t& g) const { return _prototypes.contains({ g.obj_file, g.accel }); }
+    uint32_t num_prototypes() const { return _prototypes.size(); }
+    uint32_t num_instances() const { return _instances.size(); }
+    const Instance& instance(uint32_t idx) const { return _instances[idx]; }
+    bool packet_traversal() const { return _grids_only; }
 
-    bool hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const;
+    void add(const objl::Loader& loader, const geometry_params_t& g);
+    void add(const geometry_params_t& g);
+    void build_top_level();
 
-    friend Mesh;
+    bool hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const;
+    bool occluded(const Ray& r_in, const Interval& ray_t) const;
+    void hit(ray_packet_t& packet) const;
+    void hit(const RayQueue& rays, const Interval& ray_t, std::vector<intersection_t>& isects) const;
+    HitRecord hit_record(const Ray& r_in, const intersection_t& isect) const { return _instances[isect.instance].hit_record(r_in, isect); }
 }; // class MeshList
 #endif
\ No newline at end of file
@@ -4,7 +4,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
 #include <optional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <thread>
 
 template<typename T>
 class ThreadSafeQueue {
@@ -69,8 +76,175 @@ public:
     }
 }; // class ThreadSafeQueue 
 
-typedef struct ScanLine {
-    uint32_t row;
-    std::vector<uint32_t> values;
-} scanline_t;
+template<typename T>
+class MpscRingBuffer {
+    /**
+     * @brief: bounded lock-free queue, any number of threads push and a
+     * single thread pops, possibly many items at once
+     * @details: every slot carries a sequence number telling whether it
+     * is free for the push of lap k or holds the item of lap k (Vyukov).
+     * Producers only contend on the tail counter, one CAS per push, the
+     * consumer owns the head and never touches shared counters.
+     * The capacity is rounded up to a power of 2
+     */
+private:
+    struct Slot {
+        std::atomic<size_t> seq;
+        T val;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask{};
+    alignas(64) std::atomic<size_t> _tail{ 0 }; // next push, shared by the producers
+    alignas(64) size_t _head{ 0 }; // next pop, consumer only
+
+public:
+    explicit MpscRingBuffer(size_t capacity) {
+        size_t size{ 1 };
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _slots = std::make_unique<Slot[]>(size);
+        _mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            _slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    size_t capacity() const { return _mask + 1; }
+
+    bool try_push(T&& val) {
+        /**
+         * @brief: false if the buffer is full, val is left untouched then
+         */
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &_slots[pos & _mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // the consumer has not freed the slot of the previous lap
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->val = std::move(val);
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    void push(T&& val) {
+        while (!try_push(std::move(val))) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::optional<T> try_pop() {
+        Slot& slot = _slots[_head & _mask];
+        if (slot.seq.load(std::memory_order_acquire) != _head + 1) {
+            return std::optional<T>();
+        }
+
+        std::optional<T> res = std::move(slot.val);
+        slot.seq.store(_head + _mask + 1, std::memory_order_release);
+        ++_head;
+
+        return res;
+    }
+
+    template<typename OutputIt>
+    size_t try_pop_batch(OutputIt out, size_t max_items) {
+        /**
+         * @brief: moves up to max_items in out, in push order,
+         * and returns how many were popped
+         */
+        size_t n{ 0 };
+        while (n < max_items) {
+            Slot& slot = _slots[_head & _mask];
+            if (slot.seq.load(std::memory_order_acquire) != _head + 1) {
+                break;
+            }
+
+            *out++ = std::move(slot.val);
+            slot.seq.store(_head + _mask + 1, std::memory_order_release);
+            ++_head;
+            ++n;
+        }
+
+        return n;
+    }
+
+    bool empty() const {
+        // exact only on the consumer thread, producers may be mid push
+        return _slots[_head & _mask].seq.load(std::memory_order_acquire) != _head + 1;
+    }
+}; // class MpscRingBuffer
+
+template<typename T>
+class WorkStealingQueue {
+    /**
+     * @brief: per-thread task deque, the owner thread consumes
+     * from the front while idle threads steal from the back, so
+     * owner and thieves rarely contend for the same end
+     */
+private:
+    mutable std::mutex mut;
+    std::deque<T> data_deque;
+
+public:
+    WorkStealingQueue() {}
+
+    void push(T&& val) {
+        std::lock_guard<std::mutex> lk(mut);
+        data_deque.push_back(std::move(val));
+    }
+
+    std::optional<T> try_pop() {
+        std::lock_guard<std::mutex> lk(mut);
+        if (data_deque.empty()) {
+            return std::optional<T>();
+        }
+
+        std::optional<T> res = std::move(data_deque.front());
+        data_deque.pop_front();
+
+        return res;
+    }
+
+    std::optional<T> try_steal() {
+        std::lock_guard<std::mutex> lk(mut);
+        if (data_deque.empty()) {
+            return std::optional<T>();
+        }
+
+        std::optional<T> res = std::move(data_deque.back());
+        data_deque.pop_back();
+
+        return res;
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lk(mut);
+
+        return data_deque.empty();
+    }
+}; // class WorkStealingQueue
+
+typedef struct Tile {
+    uint32_t x0, y0; // top-left pixel, inclusive
+    uint32_t x1, y1; // bottom-right pixel, exclusive
+
+    uint32_t width() const { return x1 - x0; }
+    uint32_t height() const { return y1 - y0; }
+} tile_t;
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <cstdint>
+#include <bit>
+
+#include "simd.h"
+#include "vec3.h"
+#include "ray.h"
+#include "hitrecord.h"
+#include "triangle.h"
+
+typedef struct alignas(64) RayPacket {
+    static constexpr uint32_t max_size = 64; // an 8x8 block of camera rays
+
+    float o[3][max_size];
+    float dir[3][max_size]; // unit
+    float inv_dir[3][max_size];
+    float t_min[max_size];
+    float t[max_size]; // closest hit so far, the end of the ray interval
+    float u[max_size];
+    float v[max_size];
+    uint32_t prim[max_size];
+    uint32_t instance[max_size];
+    Vec3f origin; // of the first ray
+    bool shared_origin{}; // every ray leaves from origin, as camera rays do
+    uint32_t size{};
+} ray_packet_t; // rays traced together in structure of arrays layout, the lanes past size are padding
+
+typedef struct SimdTriangle {
+    Simd::floatv v0[3];
+    Simd::floatv e1[3]; // v0 -> v1
+    Simd::floatv e2[3]; // v0 -> v2
+} simd_triangle_t; // triangle broadcast to every lane once per packet test
+
+namespace RayPackets {
+constexpr uint32_t lane_mask = (1u << Simd::width) - 1;
+
+void start(ray_packet_t& packet);
+void push(ray_packet_t& packet, const Ray& r, float t_min, float t_max);
+void close(ray_packet_t& packet);
+intersection_t intersection(const ray_packet_t& packet, uint32_t k);
+
+inline uint64_t all_rays(const ray_packet_t& packet) {
+    return packet.size == ray_packet_t::max_size ? ~uint64_t{ 0 } : (uint64_t{ 1 } << packet.size) - 1;
+}
+
+inline uint32_t chunk_rays(uint64_t rays, uint32_t chunk) {
+    /**
+     * @brief: bits of the rays of a chunk of Simd::width lanes
+     */
+    return static_cast<uint32_t>(rays >> (chunk * Simd::width)) & lane_mask;
+}
+
+inline simd_triangle_t broadcast(const Triangle& tri) {
+    simd_triangle_t t;
+    for (uint32_t i = 0; i < 3; ++i) {
+        t.v0[i] = Simd::set1(tri.v0().pos[i]);
+        t.e1[i] = Simd::set1(tri.v0v1()[i]);
+        t.e2[i] = Simd::set1(tri.v0v2()[i]);
+    }
+
+    return t;
+}
+
+inline uint64_t hit_box(const ray_packet_t& packet, const Vec3f& bmin, const Vec3f& bmax, uint64_t rays) {
+    /**
+     * @brief: slab test of the rays against a box, like BVHTree::_hit_node
+     * @return: bitmask of the rays that overlap the box in (t_min, t)
+     */
+    using namespace Simd;
+    uint64_t hits{ 0 };
+    for (uint32_t c = 0; c * width < packet.size; ++c) {
+        if (chunk_rays(rays, c) == 0) {
+            continue;
+        }
+
+        const uint32_t base = c * width;
+        floatv t_near = load(packet.t_min + base);
+        floatv t_far = load(packet.t + base);
+        for (uint32_t a = 0; a < 3; ++a) {
+            floatv o = load(packet.o[a] + base);
+            floatv inv_dir = load(packet.inv_dir[a] + base);
+            floatv t0 = (set1(bmin[a]) - o) * inv_dir;
+            floatv t1 = (set1(bmax[a]) - o) * inv_dir;
+            t_near = max(min(t0, t1), t_near);
+            t_far = min(max(t0, t1), t_far);
+        }
+        hits |= static_cast<uint64_t>(bits(t_near <= t_far)) << base;
+    }
+
+    return hits & rays;
+}
+
+inline uint32_t hit(ray_packet_t& packet, uint32_t chunk, uint32_t active, const simd_triangle_t& tri, uint32_t tri_idx) {
+    /**
+     * @brief: moller-trumbore test of one triangle against a chunk of
+     * Simd::width rays, the same arithmetic as TriBlocks::intersect with
+     * the roles of rays and triangles swapped
+     * @param active: bitmask of the lanes to test
+     * @return: bitmask of the lanes hit in (t_min, t), their closest hit
+     * is replaced by the triangle
+     */
+    using namespace Simd;
+    const float tol = 1e-8;
+    const uint32_t base = chunk * width;
+
+    floatv dir[3] = { load(packet.dir[0] + base), load(packet.dir[1] + base), load(packet.dir[2] + base) };
+
+    floatv p_x = dir[1] * tri.e2[2] - dir[2] * tri.e2[1];
+    floatv p_y = dir[2] * tri.e2[0] - dir[0] * tri.e2[2];
+    floatv p_z = dir[0] * tri.e2[1] - dir[1] * tri.e2[0];
+    floatv det = tri.e1[0] * p_x + tri.e1[1] * p_y + tri.e1[2] * p_z;
+    floatv det_inv = set1(1.f) / det;
+
+    floatv t_x = load(packet.o[0] + base) - tri.v0[0];
+    floatv t_y = load(packet.o[1] + base) - tri.v0[1];
+    floatv t_z = load(packet.o[2] + base) - tri.v0[2];
+    floatv u = (t_x * p_x + t_y * p_y + t_z * p_z) * det_inv;
+
+    floatv q_x = t_y * tri.e1[2] - t_z * tri.e1[1];
+    floatv q_y = t_z * tri.e1[0] - t_x * tri.e1[2];
+    floatv q_z = t_x * tri.e1[1] - t_y * tri.e1[0];
+    floatv v = (dir[0] * q_x + dir[1] * q_y + dir[2] * q_z) * det_inv;
+    floatv t = (tri.e2[0] * q_x + tri.e2[1] * q_y + tri.e2[2] * q_z) * det_inv;
+
+    floatv zero = set1(0.f);
+    floatv one = set1(1.f);
+    maskv valid = (max(det, zero - det) >= set1(tol)) & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one)
+                & (t > load(packet.t_min + base)) & (t < load(packet.t + base));
+
+    uint32_t hits = bits(valid) & active;
+    if (hits == 0) {
+        return 0;
+    }
+
+    alignas(64) float ts[width], us[width], vs[width];
+    store(ts, t);
+    store(us, u);
+    store(vs, v);
+
+    // every lane is its own ray, so the hit lanes are all closer than before
+    for (uint32_t m = hits; m != 0; m &= m - 1) {
+        uint32_t lane = std::countr_zero(m);
+        packet.t[base + lane] = ts[lane];
+        packet.u[base + lane] = us[lane];
+        packet.v[base + lane] = vs[lane];
+        packet.prim[base + lane] = tri_idx;
+    }
+
+    return hits;
+}
+} // namespace RayPackets
+#endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "framebuffer.h"
+#include "multithreading.h"
+
+class Deflater {
+    /**
+     * @brief: streaming zlib encoder, the input is given a piece at a time
+     * and every piece is compressed as soon as it arrives
+     * @details: greedy LZ77 over a 32K window with hash chains and the fixed
+     * Huffman codes, the same scheme as stb_image_write. Every piece is one
+     * deflate block, matches can reach back into the previous pieces
+     */
+private:
+    static constexpr uint32_t _window = 1u << 15;
+    static constexpr uint32_t _hash_bits = 15;
+    static constexpr uint32_t _max_chain = 32;
+    static constexpr uint32_t _min_match = 3;
+    static constexpr uint32_t _max_match = 258;
+
+    std::vector<uint8_t> _data; // last window of the input plus the piece being compressed
+    size_t _base{ 0 }; // stream position of _data[0]
+    std::vector<int64_t> _head; // last stream position of every hash
+    std::vector<int64_t> _prev; // previous position with the same hash, indexed by position % window
+    uint32_t _adler_a{ 1 };
+    uint32_t _adler_b{ 0 };
+    uint64_t _bits{ 0 };
+    uint32_t _num_bits{ 0 };
+    std::vector<uint8_t> _out;
+
+    void _put_bits(uint32_t value, uint32_t count);
+    void _put_huffman(uint32_t code, uint32_t length);
+    void _put_literal(uint32_t symbol);
+    void _put_match(uint32_t length, uint32_t dist);
+    uint32_t _hash(size_t pos) const;
+    void _insert(size_t pos);
+
+public:
+    Deflater();
+
+    std::vector<uint8_t> compress(const uint8_t* data, size_t size);
+    std::vector<uint8_t> finish();
+}; // class Deflater
+
+class PngWriter {
+    /**
+     * @brief: writes the framebuffer to a .png file on its own thread, the
+     * rows are filtered and compressed in order as soon as they are final
+     * @details: render threads report the tiles that will not change
+     * anymore, rows are final once every pixel on them was reported. The
+     * file is complete shortly after the last row, and the display
+     * thread never waits for it
+     */
+private:
+    const Framebuffer& _framebuffer;
+    std::string _path;
+    std::vector<uint32_t> _row_pixels; // final pixels of every row
+    uint32_t _ready_rows{ 0 }; // rows before it are final
+    bool _aborted{ false };
+    bool _ok{ false };
+    std::mutex _mut;
+    std::condition_variable _cv;
+    std::thread _thread;
+
+    void _run();
+    void _write_chunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) const;
+    void _filter_row(uint32_t j, std::vector<uint8_t>& out) const;
+
+public:
+    PngWriter(const Framebuffer& framebuffer, const std::string& path);
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+    ~PngWriter();
+
+    void tile_final(const tile_t& tile);
+    bool finish();
+    void abort();
+}; // class PngWriter
+#endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define RANDOM_H
 
 #include <random>
+#include <cstdint>
 
 namespace RandomUtils {
 inline static std::mt19937 generate_engine() {
@@ -12,7 +13,7 @@ inline static std::mt19937 generate_engine() {
     return std::mt19937{ss};
 }
 
-inline static std::mt19937 _random_engine{ generate_engine() };
+inline static thread_local std::mt19937 _random_engine{ generate_engine() }; // one engine per render thread
 
 inline uint32_t xor128() {
     /**
@@ -23,10 +24,10 @@ inline uint32_t xor128() {
      * a problem per se in raytracing
      */
 
-    static uint32_t x = 123456789;
-    static uint32_t y = 362436069;
-    static uint32_t z = 521288629;
-    static uint32_t w = 88675123;
+    thread_local uint32_t x = 123456789;
+    thread_local uint32_t y = 362436069;
+    thread_local uint32_t z = 521288629;
+    thread_local uint32_t w = 88675123;
     uint32_t t;
 
     t = x ^ (x << 11);
@@ -67,5 +68,62 @@ inline uint32_t random_int(uint32_t min, uint32_t max, bool mt = false) {
 
     return static_cast<uint32_t>(random_float(min, max, mt));
 }
+
+inline uint64_t splitmix64(uint64_t x) {
+    /**
+     * @brief: splitmix64 finalizer, turns close keys into unrelated seeds
+     */
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+
+    return x ^ (x >> 31);
+}
+
+class Pcg32 {
+    /**
+     * @brief: PCG-XSH-RR generator, 16 bytes of state so that a fresh
+     * one can be created for every pixel sample
+     * @details: see https://www.pcg-random.org, the stream selects one
+     * of 2^63 distinct sequences
+     */
+private:
+    uint64_t _state{ 0 };
+    uint64_t _inc;
+
+public:
+    Pcg32(uint64_t seed, uint64_t stream) : _inc((stream << 1u) | 1u) {
+        next_uint();
+        _state += seed;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old = _state;
+        _state = old * 6364136223846793005ull + _inc;
+        auto xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        auto rot = static_cast<uint32_t>(old >> 59u);
+
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    float next_float() {
+        // 24 random mantissa bits, the result is in [0, 1)
+        return (next_uint() >> 8) * 0x1p-24f;
+    }
+}; // class Pcg32
+
+inline Pcg32 sample_rng(uint32_t i, uint32_t j, uint32_t sample, uint32_t bounce = 0) {
+    /**
+     * @brief: random stream of a path, keyed on the pixel (i, j), the
+     * sample index and the bounce
+     * @details: it depends on nothing else, so the image is the same
+     * whatever the number of threads and the order tiles are rendered in
+     */
+    uint64_t pixel = (static_cast<uint64_t>(j) << 32) | i;
+    uint64_t path = (static_cast<uint64_t>(bounce) << 32) | sample;
+
+    return Pcg32{ splitmix64(pixel ^ splitmix64(path)), pixel };
+}
 } // namespace RandomUtils
 #endif
\ No newline at end of file
@@ -0,0 +1,252 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <numbers>
+
+#include "input.h"
+#include "random.h"
+#include "vec3.h"
+
+typedef struct Sample2D {
+    float x{};
+    float y{};
+} sample_2d_t; // point in [0, 1)^2
+
+namespace Sobol {
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+
+    return (x >> 16) | (x << 16);
+}
+
+inline uint32_t sobol(uint32_t index, uint32_t dim) {
+    /**
+     * @brief: first two dimensions of the Sobol sequence, as 0.32 fixed point
+     * @details: dimension 0 is the van der Corput sequence. The generator
+     * matrix of dimension 1 is the Pascal triangle mod 2, a Kronecker power
+     * of [[1, 0], [1, 1]], so it is applied with one xor butterfly per level
+     * instead of one xor per index bit
+     */
+    if (dim == 0) {
+        return reverse_bits(index);
+    }
+
+    index ^= (index & 0xaaaaaaaau) >> 1;
+    index ^= (index & 0xccccccccu) >> 2;
+    index ^= (index & 0xf0f0f0f0u) >> 4;
+    index ^= (index & 0xff00ff00u) >> 8;
+    index ^= (index & 0xffff0000u) >> 16;
+
+    return reverse_bits(index);
+}
+
+inline uint32_t laine_karras(uint32_t x, uint32_t seed) {
+    /**
+     * @brief: hash where every bit is flipped depending only on the bits
+     * below it, Owen scrambling of the bit reversed value
+     * (Burley, "Practical Hash-based Owen Scrambling")
+     */
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+
+    return x;
+}
+
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras(reverse_bits(x), seed));
+}
+
+inline float to_float(uint32_t x) {
+    // 24 bits so that the result stays below 1
+    return (x >> 8) * 0x1p-24f;
+}
+
+inline sample_2d_t owen_2d(uint32_t index, uint64_t seed) {
+    /**
+     * @brief: point index of a shuffled and Owen scrambled 2D Sobol
+     * sequence, the first 2^k points of any seed are a (0, k, 2)-net
+     * @details: same as scrambling sobol(shuffled, 0) and sobol(shuffled, 1)
+     * with nested_uniform_scramble, with the back to back bit reversals
+     * cancelled out
+     */
+    uint32_t s0 = static_cast<uint32_t>(seed);
+    uint32_t s1 = static_cast<uint32_t>(seed >> 32);
+    uint32_t shuffled = reverse_bits(laine_karras(reverse_bits(index), s0));
+    uint32_t x = laine_karras(shuffled, s1);
+    uint32_t y = laine_karras(reverse_bits(sobol(shuffled, 1)), s0 ^ s1 ^ 0x9e3779b9u);
+
+    return { to_float(reverse_bits(x)), to_float(reverse_bits(y)) };
+}
+} // namespace Sobol
+
+namespace Warp {
+inline void orthonormal_basis(const Vec3f& n, Vec3f& t, Vec3f& b) {
+    /**
+     * @brief: tangent and bitangent of the unit vector n, without branches
+     * on n nor normalizations (Duff et al., "Building an Orthonormal Basis, Revisited")
+     */
+    float sign = std::copysign(1.f, n.z());
+    float a = -1.f / (sign + n.z());
+    float c = n.x() * n.y() * a;
+    t = Vec3f(1.f + sign * n.x() * n.x() * a, sign * c, -sign * n.x());
+    b = Vec3f(c, sign + n.y() * n.y() * a, -n.y());
+}
+
+inline Vec3f cosine_hemisphere(const Vec3f& n, sample_2d_t u) {
+    /**
+     * @brief: direction around the unit normal n with pdf cos(theta) / pi,
+     * a uniform point of the unit disk projected up to the hemisphere
+     */
+    float r = std::sqrt(u.x);
+    float phi = 2.f * std::numbers::pi_v<float> * u.y;
+    float z = std::sqrt(std::max(0.f, 1.f - u.x));
+    Vec3f t, b;
+    orthonormal_basis(n, t, b);
+
+    return r * std::cos(phi) * t + r * std::sin(phi) * b + z * n;
+}
+} // namespace Warp
+
+class AliasTable {
+    /**
+     * @brief: draws an index with probability proportional to its
+     * weight in constant time, whatever the number of weights
+     * @details: Vose's alias method, every bin holds the probability of
+     * its own index and the index filling the rest of the bin. A single
+     * uniform number picks the bin and, with its fractional part, one of
+     * the two indices
+     */
+private:
+    std::vector<float> _prob; // probability of keeping the bin's own index
+    std::vector<uint32_t> _alias;
+    std::vector<float> _pdf; // normalized weights
+
+public:
+    AliasTable() = default;
+    AliasTable(const std::vector<float>& weights);
+
+    bool empty() const { return _pdf.empty(); }
+    uint32_t size() const { return _pdf.size(); }
+    float pdf(uint32_t idx) const { return _pdf[idx]; }
+
+    uint32_t sample(float u) const {
+        float scaled = u * _pdf.size();
+        uint32_t bin = std::min(static_cast<uint32_t>(scaled), size() - 1);
+
+        return scaled - bin < _prob[bin] ? bin : _alias[bin];
+    }
+}; // class AliasTable
+
+namespace BlueNoise {
+constexpr uint32_t mask_size = 64;
+
+const std::vector<float>& mask();
+} // namespace BlueNoise
+
+class IndependentSampler {
+    /**
+     * @brief: uncorrelated uniform samples, the reference the other samplers are compared to
+     */
+private:
+    RandomUtils::Pcg32 _rng{ 0, 0 };
+
+public:
+    void start(uint32_t i, uint32_t j, uint32_t sample) { _rng = RandomUtils::sample_rng(i, j, sample); }
+    float get_1d() { return _rng.next_float(); }
+    sample_2d_t get_2d() { return { _rng.next_float(), _rng.next_float() }; }
+}; // class IndependentSampler
+
+class SobolSampler {
+    /**
+     * @brief: every pair of dimensions is its own Owen scrambled Sobol
+     * sequence, seeded by the pixel and the dimension (padding)
+     * @details: any number of samples and dimensions can be drawn, with
+     * a power of 2 samples per pixel every 2D projection is a (0, k, 2)-net
+     */
+private:
+    uint64_t _pixel_seed{};
+    uint32_t _sample{};
+    uint32_t _dim{};
+
+public:
+    void start(uint32_t i, uint32_t j, uint32_t sample) {
+        _pixel_seed = RandomUtils::splitmix64((static_cast<uint64_t>(j) << 32) | i);
+        _sample = sample;
+        _dim = 0;
+    }
+
+    float get_1d() { return get_2d().x; }
+    sample_2d_t get_2d() { return Sobol::owen_2d(_sample, RandomUtils::splitmix64(_pixel_seed + _dim++)); }
+}; // class SobolSampler
+
+class BlueNoiseSampler {
+    /**
+     * @brief: the same scrambled Sobol points for every pixel, shifted
+     * (Cranley-Patterson rotation) by a blue noise mask tiled over the image
+     * @details: neighbouring pixels get far apart shifts, so at low sample
+     * counts the error is pushed to high frequencies where it is least visible.
+     * Each dimension reads the mask at a different toroidal offset
+     */
+private:
+    const float* _mask{ BlueNoise::mask().data() };
+    uint32_t _i{};
+    uint32_t _j{};
+    uint32_t _sample{};
+    uint32_t _dim{};
+
+    float _shift(uint32_t d) const;
+
+public:
+    void start(uint32_t i, uint32_t j, uint32_t sample) {
+        _i = i;
+        _j = j;
+        _sample = sample;
+        _dim = 0;
+    }
+
+    float get_1d() { return get_2d().x; }
+    sample_2d_t get_2d();
+}; // class BlueNoiseSampler
+
+class Sampler {
+    /**
+     * @brief: source of the pixel and path samples, start() selects the
+     * sample of a pixel and every get_1d()/get_2d() call draws the next dimension
+     * @details: one per render thread or tile, the sequence of a sample
+     * depends only on (i, j, sample), never on the rendering order
+     */
+private:
+    std::variant<IndependentSampler, SobolSampler, BlueNoiseSampler> _sampler;
+
+    template<typename F>
+    decltype(auto) _visit(F&& f) {
+        // called a few times per sample, a plain switch inlines where std::visit does not
+        switch (_sampler.index()) {
+            case 0:
+                return f(*std::get_if<0>(&_sampler));
+            case 1:
+                return f(*std::get_if<1>(&_sampler));
+            default:
+                return f(*std::get_if<2>(&_sampler));
+        }
+    }
+
+public:
+    Sampler(SamplerType type);
+
+    void start(uint32_t i, uint32_t j, uint32_t sample) { _visit([&](auto& s) { s.start(i, j, sample); }); }
+    float get_1d() { return _visit([](auto& s) { return s.get_1d(); }); }
+    sample_2d_t get_2d() { return _visit([](auto& s) { return s.get_2d(); }); }
+}; // class Sampler
+#endif
\ No newline at end of file
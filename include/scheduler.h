@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include "multithreading.h"
+
+class RenderScheduler {
+private:
+    uint32_t _num_threads;
+    std::vector<tile_t> _tiles;
+    std::vector<WorkStealingQueue<tile_t>> _queues; // one deque per worker thread
+
+    void _split_tiles(uint32_t width, uint32_t height, uint32_t tile_size);
+    void _seed_queues();
+    std::optional<tile_t> _steal(uint32_t thief);
+    void _worker(uint32_t id, const std::function<void(const tile_t&)>& job, const std::atomic<bool>& cancel);
+
+public:
+    RenderScheduler(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t num_threads = 0);
+    RenderScheduler(const RenderScheduler&) = delete;
+    RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+    uint32_t num_threads() const { return _num_threads; }
+    uint32_t num_tiles() const { return _tiles.size(); }
+
+    void run(const std::function<void(const tile_t&)>& job, const std::atomic<bool>& cancel);
+}; // class RenderScheduler
+#endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+// gcc 12 flags the undefined pass-through operands of the AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
+
+namespace Simd {
+/**
+ * @brief: thin wrappers over the widest float vector the target supports,
+ * picked at compile time (AVX-512, AVX2, SSE2 or a plain array fallback),
+ * so that kernels can be written once for every width
+ * @details: masks convert to a bitmask with one bit per lane, lane 0 being
+ * the least significant bit. min and max return the second operand in
+ * the lanes where the first one is NaN. intv holds 32 bit integer lanes,
+ * enough to build packed pixels
+ */
+#if defined(__AVX512F__)
+constexpr uint32_t width = 16;
+
+struct floatv { __m512 v; };
+struct maskv { __mmask16 m; };
+
+inline floatv load(const float* p) { return { _mm512_load_ps(p) }; }
+inline void store(float* p, floatv a) { _mm512_store_ps(p, a.v); }
+inline floatv set1(float x) { return { _mm512_set1_ps(x) }; }
+inline floatv operator+(floatv a, floatv b) { return { _mm512_add_ps(a.v, b.v) }; }
+inline floatv operator-(floatv a, floatv b) { return { _mm512_sub_ps(a.v, b.v) }; }
+inline floatv operator*(floatv a, floatv b) { return { _mm512_mul_ps(a.v, b.v) }; }
+inline floatv operator/(floatv a, floatv b) { return { _mm512_div_ps(a.v, b.v) }; }
+inline maskv operator<(floatv a, floatv b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline maskv operator<=(floatv a, floatv b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+inline maskv operator>(floatv a, floatv b) { return b < a; }
+inline maskv operator>=(floatv a, floatv b) { return b <= a; }
+inline maskv operator&(maskv a, maskv b) { return { static_cast<__mmask16>(a.m & b.m) }; }
+inline uint32_t bits(maskv a) { return a.m; }
+inline floatv min(floatv a, floatv b) { return { _mm512_min_ps(a.v, b.v) }; }
+inline floatv max(floatv a, floatv b) { return { _mm512_max_ps(a.v, b.v) }; }
+inline floatv sqrt(floatv a) { return { _mm512_sqrt_ps(a.v) }; }
+
+struct intv { __m512i v; };
+
+inline intv to_int(floatv a) { return { _mm512_cvttps_epi32(a.v) }; } // truncates
+inline intv set1_int(uint32_t x) { return { _mm512_set1_epi32(static_cast<int>(x)) }; }
+inline intv operator|(intv a, intv b) { return { _mm512_or_si512(a.v, b.v) }; }
+inline intv shift_left(intv a, uint32_t n) { return { _mm512_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+inline void storeu(uint32_t* p, intv a) { _mm512_storeu_si512(p, a.v); }
+#elif defined(__AVX2__)
+constexpr uint32_t width = 8;
+
+struct floatv { __m256 v; };
+struct maskv { __m256 m; };
+
+inline floatv load(const float* p) { return { _mm256_load_ps(p) }; }
+inline void store(float* p, floatv a) { _mm256_store_ps(p, a.v); }
+inline floatv set1(float x) { return { _mm256_set1_ps(x) }; }
+inline floatv operator+(floatv a, floatv b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline floatv operator-(floatv a, floatv b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline floatv operator*(floatv a, floatv b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline floatv operator/(floatv a, floatv b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline maskv operator<(floatv a, floatv b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline maskv operator<=(floatv a, floatv b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline maskv operator>(floatv a, floatv b) { return b < a; }
+inline maskv operator>=(floatv a, floatv b) { return b <= a; }
+inline maskv operator&(maskv a, maskv b) { return { _mm256_and_ps(a.m, b.m) }; }
+inline uint32_t bits(maskv a) { return static_cast<uint32_t>(_mm256_movemask_ps(a.m)); }
+inline floatv min(floatv a, floatv b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline floatv max(floatv a, floatv b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline floatv sqrt(floatv a) { return { _mm256_sqrt_ps(a.v) }; }
+
+struct intv { __m256i v; };
+
+inline intv to_int(floatv a) { return { _mm256_cvttps_epi32(a.v) }; } // truncates
+inline intv set1_int(uint32_t x) { return { _mm256_set1_epi32(static_cast<int>(x)) }; }
+inline intv operator|(intv a, intv b) { return { _mm256_or_si256(a.v, b.v) }; }
+inline intv shift_left(intv a, uint32_t n) { return { _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+inline void storeu(uint32_t* p, intv a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a.v); }
+#elif defined(__SSE2__)
+constexpr uint32_t width = 4;
+
+struct floatv { __m128 v; };
+struct maskv { __m128 m; };
+
+inline floatv load(const float* p) { return { _mm_load_ps(p) }; }
+inline void store(float* p, floatv a) { _mm_store_ps(p, a.v); }
+inline floatv set1(float x) { return { _mm_set1_ps(x) }; }
+inline floatv operator+(floatv a, floatv b) { return { _mm_add_ps(a.v, b.v) }; }
+inline floatv operator-(floatv a, floatv b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline floatv operator*(floatv a, floatv b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline floatv operator/(floatv a, floatv b) { return { _mm_div_ps(a.v, b.v) }; }
+inline maskv operator<(floatv a, floatv b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline maskv operator<=(floatv a, floatv b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline maskv operator>(floatv a, floatv b) { return b < a; }
+inline maskv operator>=(floatv a, floatv b) { return b <= a; }
+inline maskv operator&(maskv a, maskv b) { return { _mm_and_ps(a.m, b.m) }; }
+inline uint32_t bits(maskv a) { return static_cast<uint32_t>(_mm_movemask_ps(a.m)); }
+inline floatv min(floatv a, floatv b) { return { _mm_min_ps(a.v, b.v) }; }
+inline floatv max(floatv a, floatv b) { return { _mm_max_ps(a.v, b.v) }; }
+inline floatv sqrt(floatv a) { return { _mm_sqrt_ps(a.v) }; }
+
+struct intv { __m128i v; };
+
+inline intv to_int(floatv a) { return { _mm_cvttps_epi32(a.v) }; } // truncates
+inline intv set1_int(uint32_t x) { return { _mm_set1_epi32(static_cast<int>(x)) }; }
+inline intv operator|(intv a, intv b) { return { _mm_or_si128(a.v, b.v) }; }
+inline intv shift_left(intv a, uint32_t n) { return { _mm_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+inline void storeu(uint32_t* p, intv a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.v); }
+#else
+constexpr uint32_t width = 4;
+
+struct floatv { float v[width]; };
+struct maskv { uint32_t m; };
+
+inline floatv load(const float* p) { floatv r{}; std::copy(p, p + width, r.v); return r; }
+inline void store(float* p, floatv a) { std::copy(a.v, a.v + width, p); }
+inline floatv set1(float x) { floatv r{}; std::fill(r.v, r.v + width, x); return r; }
+
+template<typename Op>
+inline floatv lanewise(floatv a, floatv b, Op op) {
+    floatv r{};
+    for (uint32_t i = 0; i < width; ++i) {
+        r.v[i] = op(a.v[i], b.v[i]);
+    }
+
+    return r;
+}
+
+template<typename Op>
+inline maskv compare(floatv a, floatv b, Op op) {
+    maskv r{ 0 };
+    for (uint32_t i = 0; i < width; ++i) {
+        r.m |= static_cast<uint32_t>(op(a.v[i], b.v[i])) << i;
+    }
+
+    return r;
+}
+
+inline floatv operator+(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x + y; }); }
+inline floatv operator-(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x - y; }); }
+inline floatv operator*(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x * y; }); }
+inline floatv operator/(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x / y; }); }
+inline maskv operator<(floatv a, floatv b) { return compare(a, b, [](float x, float y) { return x < y; }); }
+inline maskv operator<=(floatv a, floatv b) { return compare(a, b, [](float x, float y) { return x <= y; }); }
+inline maskv operator>(floatv a, floatv b) { return b < a; }
+inline maskv operator>=(floatv a, floatv b) { return b <= a; }
+inline maskv operator&(maskv a, maskv b) { return { a.m & b.m }; }
+inline uint32_t bits(maskv a) { return a.m; }
+inline floatv min(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline floatv max(floatv a, floatv b) { return lanewise(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline floatv sqrt(floatv a) { return lanewise(a, a, [](float x, float) { return std::sqrt(x); }); }
+
+struct intv { uint32_t v[width]; };
+
+inline intv to_int(floatv a) {
+    intv r{};
+    for (uint32_t i = 0; i < width; ++i) {
+        r.v[i] = static_cast<uint32_t>(static_cast<int32_t>(a.v[i]));
+    }
+
+    return r;
+}
+
+inline intv set1_int(uint32_t x) { intv r{}; std::fill(r.v, r.v + width, x); return r; }
+
+inline intv operator|(intv a, intv b) {
+    for (uint32_t i = 0; i < width; ++i) {
+        a.v[i] |= b.v[i];
+    }
+
+    return a;
+}
+
+inline intv shift_left(intv a, uint32_t n) {
+    for (uint32_t i = 0; i < width; ++i) {
+        a.v[i] <<= n;
+    }
+
+    return a;
+}
+
+inline void storeu(uint32_t* p, intv a) { std::copy(a.v, a.v + width, p); }
+#endif
+} // namespace Simd
+#endif
\ No newline at end of file
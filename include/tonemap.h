@@ -0,0 +1,40 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <cstdint>
+
+#include "SDL3/SDL.h"
+
+#include "color.h"
+#include "input.h"
+#include "simd.h"
+
+class Tonemapper {
+    /**
+     * @brief: output stage from linear radiance to display pixels, the
+     * tonemapping curve, gamma correction, clamping and 8 bit packing are
+     * done in a single simd pass over a span of pixels
+     * @details: the channel shifts of the pixel format are looked up once,
+     * when the tonemapper is built, instead of once per pixel
+     */
+private:
+    TonemapType _tonemap{ TonemapType::none };
+    bool _gamma_corr{ true };
+    uint32_t _r_shift{ 24 };
+    uint32_t _g_shift{ 16 };
+    uint32_t _b_shift{ 8 };
+    uint32_t _alpha{ 0xff }; // opaque alpha already in place
+
+    template<typename Curve>
+    void _pack(const float* r, const float* g, const float* b, uint32_t n, uint32_t* out, Curve curve) const;
+
+public:
+    static constexpr uint32_t span_alignment = 64; // bytes, for the simd loads
+
+    Tonemapper() = default;
+    Tonemapper(SDL_PixelFormat format, TonemapType tonemap, bool gamma_corr = true);
+
+    void pack(const float* r, const float* g, const float* b, uint32_t n, uint32_t* out) const;
+    uint32_t pack(const Color& color) const;
+}; // class Tonemapper
+#endif
\ No newline at end of file
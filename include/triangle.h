@@ -33,11 +33,17 @@ public:
     const vertex_t& v0() const { return _v0; }
     const vertex_t& v1() const { return _v1; }
     const vertex_t& v2() const { return _v2; }
+    const Vec3f& v0v1() const { return _v0v1; }
+    const Vec3f& v0v2() const { return _v0v2; }
 
     const Vec3f& get_face_normal() const { return _face_normal; }
+    const Color& get_color() const { return _color; }
     const BoundingBox& get_bbox() const { return _bbox; }
 
-    bool hit(const Ray &r_in, const Interval &ray_t, HitRecord &hitrec) const;
+    Vec3f normal_at(float u, float v) const { return (1.f - u - v) * _v0.normal + u * _v1.normal + v * _v2.normal; }
+
+    bool hit(const Ray &r_in, const Interval &ray_t, intersection_t &isect) const;
+    bool occluded(const Ray &r_in, const Interval &ray_t) const { intersection_t isect; return hit(r_in, ray_t, isect); }
 }; // class Triangle
 
 inline std::ostream& operator<<(std::ostream& out, const Triangle& v) {
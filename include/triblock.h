@@ -0,0 +1,118 @@
+#ifndef TRIBLOCK_H
+#define TRIBLOCK_H
+
+#include <vector>
+#include <cstdint>
+#include <bit>
+
+#include "simd.h"
+#include "ray.h"
+#include "hitrecord.h"
+#include "triangle.h"
+
+typedef struct alignas(64) TriBlock {
+    float v0[3][Simd::width];
+    float e1[3][Simd::width]; // v0 -> v1
+    float e2[3][Simd::width]; // v0 -> v2
+    uint32_t idx[Simd::width]; // triangle of each lane, UINT32_MAX for the padding lanes
+} tri_block_t; // Simd::width triangles in structure of arrays layout
+
+typedef struct SimdRay {
+    Simd::floatv origin[3];
+    Simd::floatv dir[3];
+} simd_ray_t; // ray broadcast to every lane once per traversal
+
+namespace TriBlocks {
+constexpr uint32_t all_lanes = (1u << Simd::width) - 1;
+
+inline simd_ray_t broadcast(const Ray& r_in) {
+    simd_ray_t r;
+    for (uint32_t i = 0; i < 3; ++i) {
+        r.origin[i] = Simd::set1(r_in.origin()[i]);
+        r.dir[i] = Simd::set1(r_in.direction()[i]);
+    }
+
+    return r;
+}
+
+void set_lane(tri_block_t& block, uint32_t lane, const Triangle& tri, uint32_t tri_idx);
+void clear_lanes(tri_block_t& block, uint32_t first_lane);
+void append(std::vector<tri_block_t>& blocks, const std::vector<Triangle>& tris, const uint32_t* indices, uint32_t count);
+
+inline uint32_t intersect(const tri_block_t& block, const simd_ray_t& r, float t_min, float t_max, Simd::floatv& t, Simd::floatv& u, Simd::floatv& v) {
+    /**
+     * @brief: moller-trumbore test of one ray against all the lanes of
+     * a block, two sided like Triangle::hit
+     * @return: bitmask of the lanes hit in (t_min, t_max)
+     */
+    using namespace Simd;
+    const float tol = 1e-8;
+
+    floatv e1[3] = { load(block.e1[0]), load(block.e1[1]), load(block.e1[2]) };
+    floatv e2[3] = { load(block.e2[0]), load(block.e2[1]), load(block.e2[2]) };
+
+    floatv p_x = r.dir[1] * e2[2] - r.dir[2] * e2[1];
+    floatv p_y = r.dir[2] * e2[0] - r.dir[0] * e2[2];
+    floatv p_z = r.dir[0] * e2[1] - r.dir[1] * e2[0];
+    floatv det = e1[0] * p_x + e1[1] * p_y + e1[2] * p_z;
+    floatv det_inv = set1(1.f) / det;
+
+    floatv t_x = r.origin[0] - load(block.v0[0]);
+    floatv t_y = r.origin[1] - load(block.v0[1]);
+    floatv t_z = r.origin[2] - load(block.v0[2]);
+    u = (t_x * p_x + t_y * p_y + t_z * p_z) * det_inv;
+
+    floatv q_x = t_y * e1[2] - t_z * e1[1];
+    floatv q_y = t_z * e1[0] - t_x * e1[2];
+    floatv q_z = t_x * e1[1] - t_y * e1[0];
+    v = (r.dir[0] * q_x + r.dir[1] * q_y + r.dir[2] * q_z) * det_inv;
+    t = (e2[0] * q_x + e2[1] * q_y + e2[2] * q_z) * det_inv;
+
+    floatv zero = set1(0.f);
+    floatv one = set1(1.f);
+    maskv valid = (max(det, zero - det) >= set1(tol)) & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one)
+                & (t > set1(t_min)) & (t < set1(t_max));
+
+    return bits(valid);
+}
+
+inline uint32_t hit(const tri_block_t& block, const simd_ray_t& r, float t_min, uint32_t active, intersection_t& closest) {
+    /**
+     * @param active: bitmask of the lanes to test
+     * @return: bitmask of the lanes hit in (t_min, closest.t), closest is
+     * replaced by the nearest of them when it is not zero
+     */
+    Simd::floatv t, u, v;
+    uint32_t hits = intersect(block, r, t_min, closest.t, t, u, v) & active;
+    if (hits == 0) {
+        return 0;
+    }
+
+    alignas(64) float ts[Simd::width], us[Simd::width], vs[Simd::width];
+    Simd::store(ts, t);
+    Simd::store(us, u);
+    Simd::store(vs, v);
+
+    for (uint32_t m = hits; m != 0; m &= m - 1) {
+        uint32_t lane = std::countr_zero(m);
+        if (ts[lane] < closest.t) {
+            closest.t = ts[lane];
+            closest.u = us[lane];
+            closest.v = vs[lane];
+            closest.prim = block.idx[lane];
+        }
+    }
+
+    return hits;
+}
+
+inline bool occluded(const tri_block_t& block, const simd_ray_t& r, float t_min, float t_max, uint32_t active) {
+    /**
+     * @brief: any hit test, the attributes of the hit lanes are never read
+     */
+    Simd::floatv t, u, v;
+
+    return (intersect(block, r, t_min, t_max, t, u, v) & active) != 0;
+}
+} // namespace TriBlocks
+#endif
\ No newline at end of file
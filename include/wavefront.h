@@ -0,0 +1,80 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vec3.h"
+#include "color.h"
+#include "ray.h"
+#include "hitrecord.h"
+#include "interval.h"
+#include "sampler.h"
+
+typedef struct PathState {
+    Color throughput{ 1.f };
+    Color radiance{};
+    float bsdf_pdf{}; // of the last bounce direction, 0 for camera rays
+} path_state_t; // what a path carries from one bounce to the next
+
+typedef struct ShadowRay {
+    Vec3f origin;
+    Vec3f dir;
+    float t_max{}; // 0 when there is nothing to connect
+    Color contribution; // added to the path radiance when the light is visible
+} shadow_ray_t; // next event estimation connection, traced now or queued
+
+class RayQueue {
+    /**
+     * @brief: rays of the wavefront engine, one per path still alive,
+     * as a structure of arrays so that every stage streams through the
+     * fields it needs
+     */
+private:
+    std::vector<float> _o[3];
+    std::vector<float> _d[3];
+    std::vector<float> _t_max;
+    std::vector<uint32_t> _path;
+
+public:
+    uint32_t size() const { return _path.size(); }
+    bool empty() const { return _path.empty(); }
+
+    void clear() {
+        for (uint32_t a = 0; a < 3; ++a) {
+            _o[a].clear();
+            _d[a].clear();
+        }
+        _t_max.clear();
+        _path.clear();
+    }
+
+    void push(const Vec3f& origin, const Vec3f& dir, uint32_t path, float t_max = inf) {
+        for (uint32_t a = 0; a < 3; ++a) {
+            _o[a].push_back(origin[a]);
+            _d[a].push_back(dir[a]);
+        }
+        _t_max.push_back(t_max);
+        _path.push_back(path);
+    }
+
+    Ray ray(uint32_t k) const { return Ray{ Vec3f(_o[0][k], _o[1][k], _o[2][k]), Vec3f(_d[0][k], _d[1][k], _d[2][k]) }; }
+    float t_max(uint32_t k) const { return _t_max[k]; }
+    uint32_t path(uint32_t k) const { return _path[k]; }
+    uint32_t octant(uint32_t k) const { return (_d[0][k] < 0.f) | (_d[1][k] < 0.f) << 1 | (_d[2][k] < 0.f) << 2; } // of the direction, 0 to 7
+}; // class RayQueue
+
+typedef struct WavefrontBuffers {
+    std::vector<uint32_t> pixel_i;
+    std::vector<uint32_t> pixel_j;
+    std::vector<Sampler> samplers;
+    std::vector<path_state_t> paths;
+    RayQueue rays; // of the current bounce
+    RayQueue next; // survivors, compacted for the next bounce
+    RayQueue shadows;
+    std::vector<Color> shadow_contribution;
+    std::vector<intersection_t> isects;
+    std::vector<uint32_t> hits; // rays that hit something, grouped by instance
+    std::vector<uint32_t> instance_start; // counting sort offsets
+} wavefront_buffers_t; // scratch of a render thread, reused across tiles
+#endif
\ No newline at end of file
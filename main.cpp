@@ -1,12 +1,24 @@
 #include <iostream>
+#include <string>
 
 #include "app.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool headless{ false };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg{ argv[i] };
+        if (arg == "--headless") {
+            headless = true;
+        } else {
+            std::cerr << "Unknown option '" << arg << "'\nUsage: " << argv[0] << " [--headless]\n";
+            return 1;
+        }
+    }
+
     try {
-        App app;
+        App app{ headless };
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << "\n";
     }
-}
+}
\ No newline at end of file
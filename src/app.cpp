@@ -1,33 +1,42 @@
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h" 
-
 #include <format>
 #include <chrono>
+#include <algorithm>
+#include <iterator>
 
 #include "app.h"
 #include "mesh.h"
 #include "utils.h"
+#include "pngwriter.h"
 
-App::App() {
+App::App(bool headless) {
+    /**
+     * @param headless: render without window nor event loop, also
+     * selected by the "headless" key of init_pars.json
+     */
     init_params_t init_pars = init_from_json("init/init_pars.json");
     camera_angles_t angles = angles_from_json("init/camera_angles.json");
     std::vector<geometry_params_t> geometries = geometries_from_json("init/geometry.json");
 
     _init_pars = init_pars;
-    _init_sdl();
+    _headless = headless || _init_pars.headless;
+    _accum = AccumBuffer{ _init_pars.img_width, _init_pars.img_height };
+    _framebuffer = Framebuffer{ _init_pars.img_width, _init_pars.img_height, _init_pars.tile_size };
+    if (!_headless) {
+        _init_sdl();
+    }
     auto outdir = "output/" + Utils::strip_extenstions(_init_pars.outfile_name) + "/";
     Utils::set_directory(outdir);
     _logger = std::make_shared<Logger>(outdir, _init_pars.outfile_name);
     _cam = Camera{ init_pars, angles, geometries, _logger };
-    _cam.set_pixel_format(_image_surface->format);
+    _cam.set_pixel_format(_image_format);
     _cam.set_meshes();
 }
 
 void App::_init_sdl() {
     /**
-     * @brief: initializes SDL variables,
-     * if pixel format is changed also the decoded 
-     * components in _save_png() must be changed
+     * @brief: initializes SDL variables, the streaming texture lives as
+     * long as the window and is updated from the framebuffer, if pixel
+     * format is changed the rows written by PngWriter must be repacked
      */
     bool success{ SDL_Init( SDL_INIT_VIDEO ) };
     if (!success) {
@@ -44,78 +53,123 @@ void App::_init_sdl() {
         throw std::runtime_error{ std::format("SDL failed to position the window: {}\n", SDL_GetError()) };
     }
 
-    _image_surface = SDL_CreateSurface(_init_pars.img_width, _init_pars.img_height, SDL_PIXELFORMAT_RGBA8888);
-    if (!_image_surface) {
-        throw std::runtime_error{ std::format("SDL failed to create image surface: {}\n", SDL_GetError()) };
+    _texture = SDL_CreateTexture(
+        _renderer, 
+        _image_format, 
+        SDL_TEXTUREACCESS_STREAMING, 
+        _init_pars.img_width, 
+        _init_pars.img_height);
+    if (!_texture) {
+        throw std::runtime_error{ std::format("SDL failed to create image texture: {}\n", SDL_GetError()) };
     }
 }
 
 void App::_worker_task() {
     /**
-     * @brief: logic for the screen visualization, calls the camera rendering and
-     * pushes each row in a buffer. They will be visualized at screen
-     * asynchronously
+     * @brief: logic for the screen visualization, splits the image in tiles
+     * rendered by a pool of threads that resolve each finished tile in the
+     * framebuffer and flag it. They will be visualized at screen asynchronously
+     * @details: in progressive mode every pass adds samples_per_pass
+     * samples to the accumulation buffer and publishes the running average of
+     * each tile, so a coarse preview shows up after the first pass and is
+     * refined until samples_per_pixel is reached or refining is stopped.
+     * With adaptive sampling the pixels whose error is below the
+     * threshold are skipped by the following passes, the passes then take
+     * min_samples_per_pixel samples unless samples_per_pass is set.
+     * Tiles that reached samples_per_pixel are final and go to the .png
+     * writer right away, the rest once the last pass is over
      */
+    RenderScheduler scheduler{ _init_pars.img_width, _init_pars.img_height, _init_pars.tile_size, _init_pars.threads };
+    _logger->set_render_threads(scheduler.num_threads(), scheduler.num_tiles());
+
+    uint32_t spp = _init_pars.samples_per_pixel;
+    uint32_t per_pass = _init_pars.samples_per_pass != 0 ? std::min(_init_pars.samples_per_pass, spp) : spp;
+    if (_init_pars.adaptive_threshold > 0.f && _init_pars.samples_per_pass == 0) {
+        // the error is checked between passes
+        per_pass = std::max(1u, std::min(_init_pars.min_samples_per_pixel, spp));
+    }
+    uint32_t passes{ 0 };
+    float first_pass_time{};
+    auto img_path = "output/" + Utils::strip_extenstions(_init_pars.outfile_name) + "/" + _init_pars.outfile_name;
+    PngWriter png{ _framebuffer, img_path };
+
     auto t_start = std::chrono::steady_clock::now();
-    uint32_t row_idx = 0;
-    while (!_done_rendering) {
-        //scanline_t scanline{ row_idx, _cam.render_row(row_idx) };
-        _queue.push(scanline_t{ row_idx, _cam.render_row(row_idx) });
-        //_queue.push_ref(scanline);
-        if (row_idx == _init_pars.img_height - 1) {
-            _done_rendering = true;
+    while (!_quit_app && !_stop_refining &&
+           _accum.update_active(spp, _init_pars.min_samples_per_pixel, _init_pars.adaptive_threshold) > 0) {
+        scheduler.run([&](const tile_t& tile) {
+            if (_cam.render_tile(tile, per_pass, _accum)) {
+                _cam.resolve_tile(tile, _accum, _framebuffer);
+                _framebuffer.publish(tile);
+                if (_accum.complete(tile, spp)) {
+                    png.tile_final(tile);
+                }
+            }
+        }, _quit_app);
+
+        if (++passes == 1) {
+            auto t_pass = std::chrono::steady_clock::now();
+            first_pass_time = std::chrono::duration_cast<std::chrono::milliseconds>(t_pass - t_start).count() / 1000.f;
         }
-        row_idx++;
     }
+    _done_rendering = true;
 
     auto t_end = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count();
     _logger->set_rendertime(elapsed / 1000.f);
+    _logger->set_passes(passes, first_pass_time);
+    _logger->set_samples(_accum.total_samples(), static_cast<uint64_t>(_init_pars.img_width) * _init_pars.img_height);
     _logger->log();
+
+    if (_quit_app) {
+        png.abort();
+    } else if (png.finish()) {
+        std::cout << std::format("\nRendered image saved as: '{}'\n", img_path);
+    }
 }
 
-void App::_save_png() {
+bool App::_update_texture() {
     /**
-     * @detail: assuming RGBA8888 big endian pixel format
+     * @brief: uploads the tiles published since the last frame,
+     * true if there was any
+     * @details: tiles finished next to each other on the same row of
+     * tiles are merged in a single upload
      */
-    std::vector<uint8_t> rgba_pixels(_init_pars.img_width * _init_pars.img_height * 4);
-    int pixel_idx = 0;
-    for (auto& pair : _pixels_map) {
-        auto& row_pixels = pair.second;
-        for (auto pixel : row_pixels) {
-            uint8_t r = (pixel >> 24) & 0xFF;  
-            uint8_t g = (pixel >> 16) & 0xFF;  
-            uint8_t b = (pixel >> 8) & 0xFF;   
-            uint8_t a = (pixel >> 0) & 0xFF;  
-            
-            rgba_pixels[pixel_idx++] = r;
-            rgba_pixels[pixel_idx++] = g;
-            rgba_pixels[pixel_idx++] = b;
-            rgba_pixels[pixel_idx++] = a;
+    _dirty_tiles.clear();
+    _framebuffer.take_dirty(std::back_inserter(_dirty_tiles), _framebuffer.num_tiles());
+    std::sort(_dirty_tiles.begin(), _dirty_tiles.end());
+
+    size_t k{ 0 };
+    while (k < _dirty_tiles.size()) {
+        tile_t rect = _framebuffer.tile(_dirty_tiles[k]);
+        size_t next = k + 1;
+        while (next < _dirty_tiles.size() && _dirty_tiles[next] == _dirty_tiles[next - 1] + 1) {
+            tile_t t = _framebuffer.tile(_dirty_tiles[next]);
+            if (t.y0 != rect.y0) {
+                break;
+            }
+            rect.x1 = t.x1;
+            ++next;
         }
-    }
 
-    auto img_path = "output/" + Utils::strip_extenstions(_init_pars.outfile_name) + "/" + _init_pars.outfile_name;
-    auto ok = stbi_write_png(
-        (img_path).c_str(), 
-        _init_pars.img_width, 
-        _init_pars.img_height, 
-        4, 
-        rgba_pixels.data(), 
-        _init_pars.img_width * 4);
-
-    if (!ok) {
-        std::cerr << "\nFailed to save .png file\n"; 
-    } else {
-        std::cout << std::format("\nRendered image saved as: '{}'\n", img_path);
+        SDL_Rect area{ 
+            static_cast<int>(rect.x0), 
+            static_cast<int>(rect.y0), 
+            static_cast<int>(rect.width()), 
+            static_cast<int>(rect.height()) };
+        SDL_UpdateTexture(_texture, &area, _framebuffer.row(rect.y0) + rect.x0, _framebuffer.pitch() * sizeof(uint32_t));
+        k = next;
     }
+
+    return !_dirty_tiles.empty();
 }
 
 App::~App() {
+    if (_texture) {
+        SDL_DestroyTexture(_texture);
+    }
     if (_renderer) {
         SDL_DestroyRenderer(_renderer);
     }
-    SDL_DestroySurface(_image_surface);
     if (_window) {
         SDL_DestroyWindow(_window);
     }
@@ -128,38 +182,49 @@ void App::run() {
     /**
      * @brief: calls the rendering job in a separate thread and then
      * reconstruct the image on the screen while is being rendered, 
-     * a .png file is saved at the end
+     * a .png file is saved at the end. Pressing enter stops the
+     * progressive refinement after the current pass
+     * @details: headless renders run on the calling thread and only
+     * write the .png file. The window shows a texture that only receives
+     * the tiles published since the last frame, frames are presented at
+     * most max_fps times per second and only when something changed
      */
+    if (_headless) {
+        _worker_task();
+
+        return;
+    }
+
     _worker = std::thread{ &App::_worker_task, this };
+    const Uint64 frame_ms = _init_pars.max_fps > 0 ? 1000 / _init_pars.max_fps : 0;
+    bool redraw{ true };
     while(!_quit_app) {
-        std::optional<scanline_t> line = _queue.try_pop();
-        while (line && !_done_rendering) {
-            scanline_t line_val = line.value();
-            uint32_t* pixels = static_cast<uint32_t*>(_image_surface->pixels);
-            size_t begin_pixel = _image_surface->pitch / sizeof(uint32_t) * line_val.row;
-            for (size_t i = 0; i < line_val.values.size(); i++) {
-                pixels[begin_pixel + i] = line_val.values[i];
-            }
-            _pixels_map[line_val.row] = std::move(line_val.values);
-            line = _queue.try_pop();
-        }
+        bool done = _done_rendering; // read before the flags, the last tiles are published before it is set
+        redraw |= _update_texture();
 
-        if (_done_rendering && !_img_saved) {
-            _save_png();
-            _img_saved = true;
+        if (redraw) {
+            SDL_RenderTexture(_renderer, _texture, nullptr, nullptr);
+            SDL_RenderPresent(_renderer);
+            redraw = false;
         }
 
+        // handle events until the next frame is due, tiles finished meanwhile wait for it
+        Uint64 next_frame = SDL_GetTicks() + frame_ms;
         SDL_Event e;
-        if (SDL_WaitEventTimeout(&e, _done_rendering ? 100 : 0)) {
+        do {
+            Uint64 now = SDL_GetTicks();
+            Sint32 timeout = done ? 100 : static_cast<Sint32>(next_frame > now ? next_frame - now : 0);
+            if (!SDL_WaitEventTimeout(&e, timeout)) {
+                break;
+            }
+
             if (e.type == SDL_EVENT_QUIT) {
-                _done_rendering = true;
                 _quit_app = true;
+            } else if (e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_RETURN) {
+                // good enough, the image is saved once the current pass is done
+                _stop_refining = true;
             }
-        }
-
-        SDL_Texture* tex = SDL_CreateTextureFromSurface(_renderer, _image_surface);
-        SDL_RenderTexture(_renderer, tex, nullptr, nullptr);
-        SDL_DestroyTexture(tex);
-        SDL_RenderPresent(_renderer);
+            redraw = true; // the window may have been resized or exposed
+        } while (!_quit_app && SDL_GetTicks() < next_frame);
     }
 }
\ No newline at end of file
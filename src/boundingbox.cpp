@@ -16,7 +16,7 @@ BoundingBox::BoundingBox(const Vec3f& p_min, const Vec3f& p_max) {
     _volume = _span_x.size() * _span_y.size() * _span_z.size();
 }
 
-bool BoundingBox::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const {
+bool BoundingBox::hit(const Ray& r_in, const Interval& ray_t, float& t_entry) const {
     /**
      * @brief: ray-bounding box intersection algorithm
      */
@@ -42,16 +42,15 @@ bool BoundingBox::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec)
     t_min = t_min > tz_min ? t_min : tz_min;
     t_max = t_max < tz_max ? t_max : tz_max;
 
-    t_min = t_min > 0 ? t_min : t_max;
-    if (t_min < 0) {
-            return false;
-    }
-
-    if (!ray_t.contains(t_min)) {
+    // clip to the ray interval, a ray starting inside the box
+    // enters it at ray_t.min()
+    t_min = t_min > ray_t.min() ? t_min : ray_t.min();
+    t_max = t_max < ray_t.max() ? t_max : ray_t.max();
+    if (t_min > t_max) {
         return false;
     }
 
-    hitrec.set_t(t_min); 
+    t_entry = t_min;
 
     return true;
 }
\ No newline at end of file
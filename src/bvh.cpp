@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <bit>
+
+#include "bvh.h"
+#include "utils.h"
+
+struct BVHTree::BuildPrim {
+    Vec3f pmin;
+    Vec3f pmax;
+    Vec3f centroid;
+    uint32_t idx;
+};
+
+static float half_area(const Vec3f& pmin, const Vec3f& pmax) {
+    Vec3f d = pmax - pmin;
+
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+BVHTree::BVHTree(const std::vector<BoundingBox>& prim_bounds, uint32_t max_leaf_size)
+: _max_leaf_size(std::max(1u, max_leaf_size))
+{
+    std::vector<BuildPrim> prims;
+    prims.reserve(prim_bounds.size());
+    for (uint32_t i = 0; i < prim_bounds.size(); ++i) {
+        const auto& b = prim_bounds[i].bounds();
+        prims.push_back(BuildPrim{ b[0], b[1], 0.5f * (b[0] + b[1]), i });
+    }
+
+    if (prims.empty()) {
+        return;
+    }
+
+    _nodes.reserve(2 * prims.size());
+    _build(prims, 0, prims.size(), 1);
+    _nodes.shrink_to_fit();
+
+    _prim_idx.reserve(prims.size());
+    for (const auto& p : prims) {
+        _prim_idx.push_back(p.idx);
+    }
+}
+
+uint32_t BVHTree::_build(std::vector<BuildPrim>& prims, uint32_t begin, uint32_t end, uint32_t depth) {
+    /**
+     * @brief: recursively builds the subtree over prims[begin, end) and
+     * returns its root index
+     * @details: the split plane is picked among _n_bins equally spaced
+     * planes per axis, over the centroids bounds, minimizing the surface
+     * area heuristic cost N_l * A_l + N_r * A_r. Nodes are emitted in
+     * depth first order so the left child always follows its parent
+     */
+    uint32_t node_idx = _nodes.size();
+    _nodes.emplace_back();
+    _depth = std::max(_depth, depth);
+
+    Vec3f pmin{ inf };
+    Vec3f pmax{ -inf };
+    Vec3f cmin{ inf };
+    Vec3f cmax{ -inf };
+    for (uint32_t i = begin; i < end; ++i) {
+        Utils::set_pmin_pmax(pmin, pmax, prims[i].pmin);
+        Utils::set_pmin_pmax(pmin, pmax, prims[i].pmax);
+        Utils::set_pmin_pmax(cmin, cmax, prims[i].centroid);
+    }
+
+    for (uint32_t a = 0; a < 3; ++a) {
+        _nodes[node_idx].bmin[a] = pmin[a];
+        _nodes[node_idx].bmax[a] = pmax[a];
+    }
+
+    uint32_t count = end - begin;
+    auto make_leaf = [&]() {
+        _nodes[node_idx].offset = begin;
+        _nodes[node_idx].count = count;
+        ++_n_leaves;
+
+        return node_idx;
+    };
+
+    if (count <= _max_leaf_size || depth >= _max_depth - 1) {
+        return make_leaf();
+    }
+
+    // bin the centroids and sweep the bins from both sides on every axis
+    float best_cost{ inf };
+    uint32_t best_axis{ 0 };
+    uint32_t best_split{ 0 };
+    for (uint32_t a = 0; a < 3; ++a) {
+        float extent = cmax[a] - cmin[a];
+        if (extent <= 0.f) {
+            continue;
+        }
+
+        uint32_t bin_count[_n_bins]{};
+        Vec3f bin_min[_n_bins];
+        Vec3f bin_max[_n_bins];
+        std::fill(bin_min, bin_min + _n_bins, Vec3f(inf));
+        std::fill(bin_max, bin_max + _n_bins, Vec3f(-inf));
+
+        float scale = _n_bins / extent;
+        for (uint32_t i = begin; i < end; ++i) {
+            auto b = std::min<uint32_t>((prims[i].centroid[a] - cmin[a]) * scale, _n_bins - 1);
+            ++bin_count[b];
+            Utils::set_pmin_pmax(bin_min[b], bin_max[b], prims[i].pmin);
+            Utils::set_pmin_pmax(bin_min[b], bin_max[b], prims[i].pmax);
+        }
+
+        float left_cost[_n_bins]{};
+        Vec3f lmin{ inf };
+        Vec3f lmax{ -inf };
+        uint32_t n_left{ 0 };
+        for (uint32_t b = 0; b < _n_bins - 1; ++b) {
+            n_left += bin_count[b];
+            if (bin_count[b] > 0) {
+                Utils::set_pmin_pmax(lmin, lmax, bin_min[b]);
+                Utils::set_pmin_pmax(lmin, lmax, bin_max[b]);
+            }
+            left_cost[b] = n_left > 0 ? n_left * half_area(lmin, lmax) : 0.f;
+        }
+
+        Vec3f rmin{ inf };
+        Vec3f rmax{ -inf };
+        uint32_t n_right{ 0 };
+        for (uint32_t b = _n_bins - 1; b > 0; --b) {
+            n_right += bin_count[b];
+            if (bin_count[b] > 0) {
+                Utils::set_pmin_pmax(rmin, rmax, bin_min[b]);
+                Utils::set_pmin_pmax(rmin, rmax, bin_max[b]);
+            }
+            if (n_right == 0 || n_right == count) {
+                continue;
+            }
+
+            float cost = left_cost[b - 1] + n_right * half_area(rmin, rmax);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = a;
+                best_split = b;
+            }
+        }
+    }
+
+    // a leaf is cheaper than any split when the traversal cost (taken as
+    // one triangle test) plus the children's weighted cost exceeds count
+    float leaf_cost = count * half_area(pmin, pmax);
+    if (best_cost < inf && best_cost + half_area(pmin, pmax) >= leaf_cost && count <= 4 * _max_leaf_size) {
+        return make_leaf();
+    }
+
+    BuildPrim* mid;
+    if (best_cost < inf) {
+        float scale = _n_bins / (cmax[best_axis] - cmin[best_axis]);
+        mid = std::partition(prims.data() + begin, prims.data() + end, [&](const BuildPrim& p) {
+            return std::min<uint32_t>((p.centroid[best_axis] - cmin[best_axis]) * scale, _n_bins - 1) < best_split;
+        });
+    } else {
+        // all centroids coincide, fall back to an object median split
+        mid = prims.data() + begin + count / 2;
+    }
+
+    uint32_t split = static_cast<uint32_t>(mid - prims.data());
+    _build(prims, begin, split, depth + 1);
+    uint32_t right_idx = _build(prims, split, end, depth + 1);
+    _nodes[node_idx].offset = right_idx;
+    _nodes[node_idx].count = 0;
+
+    return node_idx;
+}
+
+BVH::BVH(const BoundingBox& bbox, const std::vector<Triangle>& tris, std::shared_ptr<Logger> logger, uint32_t max_leaf_size)
+: _bbox(bbox), _logger(logger)
+{
+    std::vector<BoundingBox> tri_bounds;
+    tri_bounds.reserve(tris.size());
+    for (const auto& tri : tris) {
+        tri_bounds.push_back(tri.get_bbox());
+    }
+
+    _tree = BVHTree{ tri_bounds, max_leaf_size };
+
+    const auto& order = _tree.prim_indices();
+    _leaf_blocks.resize(order.size());
+    for (const auto& node : _tree.nodes()) {
+        if (node.count > 0) {
+            _leaf_blocks[node.offset] = _blocks.size();
+            TriBlocks::append(_blocks, tris, order.data() + node.offset, node.count);
+        }
+    }
+
+    _logger->add_bvh(_tree.num_nodes(), _tree.num_leaves(), _tree.depth());
+}
+
+bool BVH::hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const {
+    /**
+     * @details: leaves are tested a block at a time, isect.prim is
+     * the triangle index in the tris the BVH was built on
+     */
+    simd_ray_t ray{ TriBlocks::broadcast(r_in) };
+    intersection_t closest_hit;
+    closest_hit.t = ray_t.max();
+    bool hit = _tree.traverse(r_in, ray_t, [&](uint32_t first, uint32_t count, float& closest) {
+        uint64_t hits{ 0 };
+        _logger->add_ray_tri_int(count);
+        for (uint32_t b = _leaf_blocks[first]; count > 0; ++b) {
+            hits += std::popcount(TriBlocks::hit(_blocks[b], ray, ray_t.min(), TriBlocks::all_lanes, closest_hit));
+            count -= std::min(count, Simd::width);
+        }
+
+        _logger->add_true_ray_tri_int(hits);
+        closest = closest_hit.t;
+
+        return hits > 0;
+    });
+
+    if (hit) {
+        isect = closest_hit;
+    }
+
+    return hit;
+}
+
+bool BVH::occluded(const Ray& r_in, const Interval& ray_t) const {
+    /**
+     * @brief: any hit query, stops at the first leaf holding a triangle hit in ray_t
+     */
+    simd_ray_t ray{ TriBlocks::broadcast(r_in) };
+
+    return _tree.traverse(r_in, ray_t, [&](uint32_t first, uint32_t count, float& closest) {
+        _logger->add_ray_tri_int(count);
+        for (uint32_t b = _leaf_blocks[first]; count > 0; ++b) {
+            if (TriBlocks::occluded(_blocks[b], ray, ray_t.min(), ray_t.max(), TriBlocks::all_lanes)) {
+                closest = -inf;
+                return true;
+            }
+            count -= std::min(count, Simd::width);
+        }
+
+        return false;
+    });
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <cmath>
+#include <algorithm>
 #include <format>
+#include <numbers>
 
 #include "camera.h"
 #include "interval.h"
@@ -13,10 +15,6 @@ Camera::Camera(
     std::shared_ptr<Logger> logger) 
 : _init_pars(init_pars), _angles(angles), _geometries(geometries), _logger(logger)
 {
-    _samples_pp_sqrt = static_cast<uint32_t>(std::sqrt(_init_pars.samples_per_pixel));
-    _samples_pp_sqrt_inv = 1.f / static_cast<float>(_samples_pp_sqrt);
-    _sampling_scale = 1.f / static_cast<float>(_init_pars.samples_per_pixel);
-
     // camera frame transformations
     _move();
 
@@ -33,6 +31,10 @@ Camera::Camera(
                                     0.5f * (img_plane_u + img_plane_v);
     
     _pixel00_loc = img_plane_upper_left + 0.5f * (_pixel_delta_u + _pixel_delta_v);
+
+    if (!_init_pars.environment_map.empty()) {
+        _environment = std::make_shared<const EnvironmentMap>("init/" + _init_pars.environment_map);
+    }
 }
 
 void Camera::_move() {
@@ -74,79 +76,166 @@ void Camera::_rotate_frame() {
     mat_vec_prod_inplace(general_rot, _v);
 }
 
-Ray Camera::_get_ray(uint32_t i, uint32_t j, uint32_t si, uint32_t sj) const {
+Vec3f Camera::_sample_pixel(uint32_t i, uint32_t j, Sampler& sampler) const {
     /**
-     * @brief: samples a ray through pixel (i,j) passing by the subpixel
-     * of indices (si,sj) for stratified sampling
+     * @brief: samples a point of pixel (i,j) on the image plane, the first
+     * sampler dimension picks the point in the unit square pixel [-0.5, 0.5]^2
      */
-    Vec3f offset = _sample_square_stratified(si, sj);
-    Vec3f pixel = _pixel00_loc + 
-                    ((i + offset.x()) * _pixel_delta_u) + 
-                    ((j + offset.y()) * _pixel_delta_v);
-    
-    return Ray{ _camera_center, pixel - _camera_center };
+    sample_2d_t offset = sampler.get_2d();
+
+    return _pixel00_loc + 
+            ((i + offset.x - 0.5f) * _pixel_delta_u) + 
+            ((j + offset.y - 0.5f) * _pixel_delta_v);
+}
+
+Ray Camera::_get_ray(uint32_t i, uint32_t j, Sampler& sampler) const {
+    return Ray{ _camera_center, _sample_pixel(i, j, sampler) - _camera_center };
 }
 
-Vec3f Camera::_sample_square_stratified(uint32_t si, uint32_t sj) const {
+void Camera::_miss(const Ray& ray, path_state_t& path) const {
     /**
-     * @brief returns the vector to a random point in the square
-     * subpixel specified by grid indices (s_i, s_j) for an 
-     * idealized unit square pixel [-0.5, -0.5] x [0.5, 0.5] 
+     * @brief: adds the background, or the environment map weighted
+     * against its light sampling, seen by a ray that left the scene
      */
-    float px = ((si + RandomUtils::random_float()) * _samples_pp_sqrt_inv) - 0.5;
-    float py = ((sj + RandomUtils::random_float()) * _samples_pp_sqrt_inv) - 0.5;
+    if (!_environment) {
+        path.radiance += path.throughput * _init_pars.background;
+
+        return;
+    }
 
-    return Vec3f(px, py, 0);
+    float weight{ 1.f };
+    if (path.bsdf_pdf > 0.f) {
+        weight = power_heuristic(path.bsdf_pdf, _lights.environment_pdf(ray.direction()));
+    }
+    path.radiance += weight * path.throughput * _environment->eval(ray.direction());
 }
 
-Color Camera::_trace(const Ray& r, uint32_t depth) const {
-    if (depth <= 0) {
-        return Color();
+bool Camera::_scatter(
+    const Ray& ray, 
+    const intersection_t& isect, 
+    uint32_t bounce, 
+    Sampler& sampler, 
+    path_state_t& path, 
+    shadow_ray_t& shadow, 
+    Vec3f& next_dir) const {
+    /**
+     * @brief: one bounce of a path on the diffuse surface hit by ray,
+     * shared by both engines
+     * @return: false if the path ends here
+     * @details: adds the emission of the surface, prepares the next event
+     * estimation connection in shadow, which the caller traces, and draws
+     * the next direction, leaving from the hit point. Light reached both
+     * ways is weighted with the power heuristic so that neither estimate
+     * is counted twice. After rr_depth bounces Russian roulette ends the
+     * path with a probability that grows as the throughput drops, the
+     * surviving paths are scaled up so the estimate stays unbiased
+     */
+    HitRecord rec = _meshes.hit_record(ray, isect);
+    const Vec3f& p = rec.get_hit_point();
+    const Color& emission = rec.get_emission();
+    if (emission.x() > 0.f || emission.y() > 0.f || emission.z() > 0.f) {
+        float weight{ 1.f };
+        if (path.bsdf_pdf > 0.f) {
+            weight = power_heuristic(path.bsdf_pdf, _lights.pdf(ray.origin(), isect, p));
+        }
+        path.radiance += weight * path.throughput * emission;
+    }
+
+    Vec3f normal = rec.get_normal();
+    if (dot(normal, ray.direction()) > 0.f) {
+        // back faces are shaded like front faces
+        normal = -normal;
     }
 
-    HitRecord rec;
-    float shadow_acne_offset = 0.001;
-    if (!_meshes.hit(r, Interval(shadow_acne_offset, inf), rec)) {
-        return _init_pars.background;
+    const Color& albedo = rec.get_color();
+    shadow.t_max = 0.f;
+    if (!_lights.empty()) {
+        float u_light = sampler.get_1d();
+        light_sample_t ls = _lights.sample(p, u_light, sampler.get_2d());
+        float cos_surface = dot(normal, ls.wi);
+        if (ls.pdf > 0.f && cos_surface > 0.f) {
+            float light_bsdf_pdf = cos_surface * std::numbers::inv_pi_v<float>;
+            float weight = power_heuristic(ls.pdf, light_bsdf_pdf);
+            shadow.origin = p;
+            shadow.dir = ls.wi;
+            shadow.t_max = ls.dist - _shadow_acne_offset;
+            shadow.contribution = (weight * light_bsdf_pdf / ls.pdf) * path.throughput * albedo * ls.emission;
+        }
     }
 
-    Color color_from_scatter = Color();
-    color_from_scatter += rec.get_color();
+    path.throughput = path.throughput * albedo;
+    next_dir = Warp::cosine_hemisphere(normal, sampler.get_2d());
+    path.bsdf_pdf = dot(normal, next_dir) * std::numbers::inv_pi_v<float>;
+
+    if (bounce + 1 >= _init_pars.rr_depth) {
+        const Color& t = path.throughput;
+        float survive = std::min(0.95f, std::max({ t.x(), t.y(), t.z() }));
+        if (sampler.get_1d() >= survive) {
+            return false;
+        }
+        path.throughput /= survive;
+    }
 
-    return color_from_scatter;
+    return true;
 }
 
-void Camera::_write_color(Color& color, std::vector<uint32_t>& row_colors) const {
+Color Camera::_trace(const Ray& r, uint32_t depth, Sampler& sampler, const intersection_t* primary) const {
     /**
-     * @brief: processes the row's pixels and put them in the buffer in order to be
-     * rendered on the screen by SDL later
+     * @brief: radiance reaching the camera along r, following the path
+     * for up to depth bounces on diffuse surfaces lit by the emissive
+     * meshes and the background, or the environment map
+     * @param primary: closest hit of r when already traced in a packet,
+     * with no instance on a miss
+     * @details: iterative, every bounce multiplies the throughput by the
+     * surface color. Directions are drawn proportional to the cosine term,
+     * which then cancels with the pdf. At every bounce a point on the
+     * lights is also sampled and connected with a shadow ray (next event
+     * estimation)
      */
-    if (_gamma_corr) {
-        _gamma_correction(color);
-    }
-    
-    float r = color.x();
-    float g = color.y();
-    float b = color.z();
+    path_state_t path;
+    Ray ray = r;
+    for (uint32_t bounce = 0; bounce < depth; ++bounce) {
+        _logger->add_ray();
+        intersection_t isect;
+        bool hit{ false };
+        if (bounce == 0 && primary) {
+            isect = *primary;
+            hit = isect.instance != UINT32_MAX;
+        } else {
+            hit = _meshes.hit(ray, Interval(_shadow_acne_offset, inf), isect);
+        }
+        if (!hit) {
+            _miss(ray, path);
+            break;
+        }
 
-    static const Interval intensity(0.000f, 0.999f);
-    auto r_byte = uint8_t(intensity.clamp(r) * 255);
-    auto g_byte = uint8_t(intensity.clamp(g) * 255);
-    auto b_byte = uint8_t(intensity.clamp(b) * 255);
+        shadow_ray_t shadow;
+        Vec3f dir;
+        bool alive = _scatter(ray, isect, bounce, sampler, path, shadow, dir);
+        if (shadow.t_max > 0.f) {
+            _logger->add_ray();
+            if (!_meshes.occluded(Ray{ shadow.origin, shadow.dir }, Interval(_shadow_acne_offset, shadow.t_max))) {
+                path.radiance += shadow.contribution;
+            }
+        }
 
-    uint32_t pixel = SDL_MapRGBA(SDL_GetPixelFormatDetails(_pixel_format), NULL, r_byte, g_byte, b_byte, 0xff);
-    row_colors.push_back(pixel);
-}
+        if (!alive) {
+            break;
+        }
+        ray = Ray{ ray.at(isect.t), dir };
+    }
 
-void Camera::_gamma_correction(Color& color) const {
-    color.set_x(linear_to_gamma(color.x()));
-    color.set_y(linear_to_gamma(color.y()));
-    color.set_z(linear_to_gamma(color.z()));
+    return path.radiance;
 }
 
 void Camera::set_meshes() {
     _meshes.set_logger(_logger);
     for (const auto& g : _geometries) {
+        if (_meshes.has_prototype(g)) {
+            _meshes.add(g);
+            continue;
+        }
+
         objl::Loader loader;
         bool ok = loader.LoadFile("init/meshes/" + g.obj_file);
         if (!ok) {
@@ -155,23 +244,265 @@ void Camera::set_meshes() {
 
         _meshes.add(loader, g);
     }
+
+    _meshes.build_top_level();
+    _lights = LightList{ _meshes, _environment };
+    _logger->set_lights(_lights.size());
 }
 
-std::vector<uint32_t> Camera::render_row(uint32_t j) {
-    std::vector<uint32_t> row_colors;
-    row_colors.reserve(_init_pars.img_width);
-    for (uint32_t i = 0; i < _init_pars.img_width; ++i) {
-        Color pixel_color;
-        for (uint32_t sj = 0; sj < _samples_pp_sqrt; ++sj) {
-            for (uint32_t si = 0; si < _samples_pp_sqrt; ++si) {
-                Ray r = _get_ray(i, j, si, sj);
-                pixel_color += _trace(r, _init_pars.depth);
+bool Camera::render_tile(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const {
+    /**
+     * @brief: adds up to n_samples samples to the active pixels of tile
+     * in accum, never going over samples_per_pixel
+     * @return: false if the tile had no active pixel
+     * @details: const and free of shared mutable state so that many
+     * threads can render different tiles at the same time. Each pixel
+     * continues from its own sample count and the samples depend only on
+     * the pixel and the sample index, so the result does not depend on
+     * which thread renders the tile nor on how the samples are split in passes
+     */
+    if (_init_pars.engine == EngineType::wavefront) {
+        return _render_tile_wavefront(tile, n_samples, accum);
+    }
+    if (_init_pars.packet_size > 0 && _meshes.packet_traversal()) {
+        return _render_tile_packets(tile, n_samples, accum);
+    }
+
+    Sampler sampler{ _init_pars.sampler };
+    bool sampled{ false };
+    for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+        for (uint32_t i = tile.x0; i < tile.x1; ++i) {
+            if (!accum.active(i, j)) {
+                continue;
+            }
+
+            sampled = true;
+            uint32_t first = accum.samples(i, j);
+            uint32_t last = std::min(first + n_samples, _init_pars.samples_per_pixel);
+            for (uint32_t s = first; s < last; ++s) {
+                sampler.start(i, j, s);
+                Ray r = _get_ray(i, j, sampler);
+                accum.add(i, j, _trace(r, _init_pars.depth, sampler));
             }
         }
-        
-        pixel_color *= _sampling_scale;
-        _write_color(pixel_color, row_colors);
     }
-    
-    return row_colors;
+
+    return sampled;
+}
+
+bool Camera::_render_tile_packets(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const {
+    /**
+     * @brief: render_tile with the camera rays traced in packets, the
+     * active pixels of every packet_size x packet_size block of the tile
+     * take their next sample together
+     * @details: camera rays share the camera center and those of a block
+     * point almost the same way, so the packet walks the grids once for
+     * all of them. The paths then go on one at a time from the packet
+     * hits, every pixel draws the same samples as in render_tile
+     */
+    const uint32_t side = _init_pars.packet_size;
+    thread_local std::vector<Sampler> samplers; // keeps its capacity, no allocation past the first tile
+    samplers.assign(side * side, Sampler{ _init_pars.sampler });
+    uint32_t pixel_i[ray_packet_t::max_size], pixel_j[ray_packet_t::max_size];
+    uint32_t first[ray_packet_t::max_size], last[ray_packet_t::max_size];
+    uint32_t pixel[ray_packet_t::max_size]; // of every ray of the packet
+    Vec3f dir[ray_packet_t::max_size];
+    ray_packet_t packet;
+    bool sampled{ false };
+    for (uint32_t y0 = tile.y0; y0 < tile.y1; y0 += side) {
+        for (uint32_t x0 = tile.x0; x0 < tile.x1; x0 += side) {
+            uint32_t n_pixels{ 0 };
+            uint32_t rounds{ 0 };
+            for (uint32_t j = y0; j < std::min(y0 + side, tile.y1); ++j) {
+                for (uint32_t i = x0; i < std::min(x0 + side, tile.x1); ++i) {
+                    if (!accum.active(i, j)) {
+                        continue;
+                    }
+
+                    pixel_i[n_pixels] = i;
+                    pixel_j[n_pixels] = j;
+                    first[n_pixels] = accum.samples(i, j);
+                    last[n_pixels] = std::min(first[n_pixels] + n_samples, _init_pars.samples_per_pixel);
+                    rounds = std::max(rounds, last[n_pixels] - first[n_pixels]);
+                    ++n_pixels;
+                }
+            }
+            sampled |= n_pixels > 0;
+
+            for (uint32_t r = 0; r < rounds; ++r) {
+                RayPackets::start(packet);
+                for (uint32_t p = 0; p < n_pixels; ++p) {
+                    if (first[p] + r >= last[p]) {
+                        continue;
+                    }
+
+                    samplers[p].start(pixel_i[p], pixel_j[p], first[p] + r);
+                    pixel[packet.size] = p;
+                    dir[packet.size] = _sample_pixel(pixel_i[p], pixel_j[p], samplers[p]) - _camera_center;
+                    RayPackets::push(packet, Ray{ _camera_center, dir[packet.size] }, _shadow_acne_offset, inf);
+                }
+                RayPackets::close(packet);
+                _meshes.hit(packet);
+
+                for (uint32_t k = 0; k < packet.size; ++k) {
+                    uint32_t p = pixel[k];
+                    intersection_t isect = RayPackets::intersection(packet, k);
+                    accum.add(pixel_i[p], pixel_j[p], _trace(Ray{ _camera_center, dir[k] }, _init_pars.depth, samplers[p], &isect));
+                }
+            }
+        }
+    }
+
+    return sampled;
+}
+
+void Camera::_run_wave(wavefront_buffers_t& wf) const {
+    /**
+     * @brief: traces the paths of wf to the end, one stage at a time
+     * over all of them
+     * @details: every bounce intersects the whole ray queue in one batched
+     * traversal, then shades the hits grouped by instance with a counting
+     * sort. Materials belong to the meshes, so sorting by instance also
+     * sorts by material and the same mesh and material data are used back
+     * to back. Meanwhile the survivors are compacted in the next queue
+     * and the light connections in the shadow queue, traced last. Every
+     * path keeps its own sampler and draws the same dimensions in the
+     * same order as _trace, so both engines give the same image
+     */
+    const uint32_t n_instances = _meshes.num_instances();
+    for (uint32_t bounce = 0; bounce < _init_pars.depth && !wf.rays.empty(); ++bounce) {
+        const uint32_t n = wf.rays.size();
+        wf.isects.resize(n);
+        _meshes.hit(wf.rays, Interval(_shadow_acne_offset, inf), wf.isects);
+        wf.instance_start.assign(n_instances + 1, 0);
+        for (uint32_t k = 0; k < n; ++k) {
+            _logger->add_ray();
+            if (wf.isects[k].instance != UINT32_MAX) {
+                ++wf.instance_start[wf.isects[k].instance + 1];
+            } else {
+                _miss(wf.rays.ray(k), wf.paths[wf.rays.path(k)]);
+            }
+        }
+
+        // counting sort of the hits by instance
+        for (uint32_t i = 0; i < n_instances; ++i) {
+            wf.instance_start[i + 1] += wf.instance_start[i];
+        }
+        wf.hits.resize(wf.instance_start[n_instances]);
+        for (uint32_t k = 0; k < n; ++k) {
+            if (wf.isects[k].instance != UINT32_MAX) {
+                wf.hits[wf.instance_start[wf.isects[k].instance]++] = k;
+            }
+        }
+
+        wf.next.clear();
+        wf.shadows.clear();
+        wf.shadow_contribution.clear();
+        for (uint32_t k : wf.hits) {
+            uint32_t path = wf.rays.path(k);
+            Ray ray = wf.rays.ray(k);
+            shadow_ray_t shadow;
+            Vec3f dir;
+            if (_scatter(ray, wf.isects[k], bounce, wf.samplers[path], wf.paths[path], shadow, dir)) {
+                wf.next.push(ray.at(wf.isects[k].t), dir, path);
+            }
+            if (shadow.t_max > 0.f) {
+                wf.shadows.push(shadow.origin, shadow.dir, path, shadow.t_max);
+                wf.shadow_contribution.push_back(shadow.contribution);
+            }
+        }
+
+        for (uint32_t k = 0; k < wf.shadows.size(); ++k) {
+            _logger->add_ray();
+            if (!_meshes.occluded(wf.shadows.ray(k), Interval(_shadow_acne_offset, wf.shadows.t_max(k)))) {
+                wf.paths[wf.shadows.path(k)].radiance += wf.shadow_contribution[k];
+            }
+        }
+
+        std::swap(wf.rays, wf.next);
+    }
+}
+
+bool Camera::_render_tile_wavefront(const tile_t& tile, uint32_t n_samples, AccumBuffer& accum) const {
+    /**
+     * @brief: render_tile for the wavefront engine, the camera rays of
+     * the tile are generated up front and traced together by _run_wave
+     * @details: waves hold at most wave_size paths so that the scratch
+     * buffers stay small whatever the samples per pass, paths are added to
+     * accum in pixel and sample order like in render_tile
+     */
+    constexpr uint32_t wave_size = 4096;
+    thread_local wavefront_buffers_t wf;
+
+    auto flush = [&]() {
+        _run_wave(wf);
+        for (uint32_t path = 0; path < wf.paths.size(); ++path) {
+            accum.add(wf.pixel_i[path], wf.pixel_j[path], wf.paths[path].radiance);
+        }
+        wf.pixel_i.clear();
+        wf.pixel_j.clear();
+        wf.samplers.clear();
+        wf.paths.clear();
+        wf.rays.clear();
+    };
+
+    bool sampled{ false };
+    for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+        for (uint32_t i = tile.x0; i < tile.x1; ++i) {
+            if (!accum.active(i, j)) {
+                continue;
+            }
+
+            sampled = true;
+            uint32_t first = accum.samples(i, j);
+            uint32_t last = std::min(first + n_samples, _init_pars.samples_per_pixel);
+            for (uint32_t s = first; s < last; ++s) {
+                uint32_t path = wf.paths.size();
+                wf.pixel_i.push_back(i);
+                wf.pixel_j.push_back(j);
+                wf.samplers.emplace_back(_init_pars.sampler);
+                wf.samplers.back().start(i, j, s);
+                wf.paths.emplace_back();
+                Vec3f pixel = _sample_pixel(i, j, wf.samplers.back());
+                wf.rays.push(_camera_center, pixel - _camera_center, path);
+                if (wf.paths.size() == wave_size) {
+                    flush();
+                }
+            }
+        }
+    }
+
+    if (!wf.paths.empty()) {
+        flush();
+    }
+
+    return sampled;
+}
+
+void Camera::resolve_tile(const tile_t& tile, const AccumBuffer& accum, Framebuffer& framebuffer) const {
+    /**
+     * @brief: writes the running average of the samples of every pixel
+     * in tile to framebuffer, in the display pixel format
+     * @details: the averages of a row are gathered in chunks of separate
+     * r, g, b spans, then tonemapped and packed a chunk at a time
+     */
+    constexpr uint32_t chunk = 64;
+    // zeroed so that the lanes past the end of a short chunk are defined
+    alignas(Tonemapper::span_alignment) float r[chunk]{};
+    alignas(Tonemapper::span_alignment) float g[chunk]{};
+    alignas(Tonemapper::span_alignment) float b[chunk]{};
+    for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+        uint32_t* row = framebuffer.row(j);
+        for (uint32_t x0 = tile.x0; x0 < tile.x1; x0 += chunk) {
+            uint32_t n = std::min(chunk, tile.x1 - x0);
+            for (uint32_t k = 0; k < n; ++k) {
+                Color c = accum.average(x0 + k, j);
+                r[k] = c.x();
+                g[k] = c.y();
+                b[k] = c.z();
+            }
+
+            _tonemapper.pack(r, g, b, n, row + x0);
+        }
+    }
 }
\ No newline at end of file
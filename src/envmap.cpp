@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <format>
+#include <numbers>
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+#include <cctype>
+
+#include "envmap.h"
+
+EnvironmentMap::EnvironmentMap(const std::string& path) {
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (ext == "pfm") {
+        _load_pfm(path);
+    } else if (ext == "hdr") {
+        _load_hdr(path);
+    } else {
+        throw std::runtime_error{ std::format("Invalid environment map '{}', expected a .pfm or .hdr file", path) };
+    }
+
+    _build_table();
+}
+
+EnvironmentMap::EnvironmentMap(uint32_t width, uint32_t height, std::vector<Color> texels)
+: _width(width), _height(height), _texels(std::move(texels))
+{
+    _build_table();
+}
+
+void EnvironmentMap::_load_pfm(const std::string& path) {
+    /**
+     * @brief: portable float map, "PF" for RGB or "Pf" for greyscale,
+     * the sign of the scale gives the byte order
+     * @details: rows are stored bottom to top
+     */
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) {
+        throw std::runtime_error{ std::format("Invalid input: file '{}' does not exists", path) };
+    }
+
+    std::string magic;
+    float scale{};
+    file >> magic >> _width >> _height >> scale;
+    file.get(); // single whitespace before the raster
+    if (!file || (magic != "PF" && magic != "Pf") || _width == 0 || _height == 0) {
+        throw std::runtime_error{ std::format("Invalid .pfm header in '{}'", path) };
+    }
+
+    const uint32_t channels = magic == "PF" ? 3 : 1;
+    const bool swap = (scale < 0.f) != (std::endian::native == std::endian::little);
+    std::vector<uint32_t> raw(static_cast<size_t>(_width) * _height * channels);
+    file.read(reinterpret_cast<char*>(raw.data()), raw.size() * sizeof(uint32_t));
+    if (!file) {
+        throw std::runtime_error{ std::format("Truncated .pfm raster in '{}'", path) };
+    }
+
+    auto value = [&](size_t idx) {
+        uint32_t bits = raw[idx];
+        if (swap) {
+            bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+        }
+
+        return std::bit_cast<float>(bits);
+    };
+
+    _texels.resize(static_cast<size_t>(_width) * _height);
+    for (uint32_t j = 0; j < _height; ++j) {
+        const size_t src_row = static_cast<size_t>(_height - 1 - j) * _width;
+        for (uint32_t i = 0; i < _width; ++i) {
+            size_t src = (src_row + i) * channels;
+            _texels[static_cast<size_t>(j) * _width + i] = channels == 3 ?
+                Color(value(src), value(src + 1), value(src + 2)) :
+                Color(value(src));
+        }
+    }
+}
+
+void EnvironmentMap::_load_hdr(const std::string& path) {
+    /**
+     * @brief: Radiance RGBE picture, flat or with the run length encoded
+     * scanlines, in the standard -Y H +X W orientation
+     */
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) {
+        throw std::runtime_error{ std::format("Invalid input: file '{}' does not exists", path) };
+    }
+
+    std::string line;
+    std::getline(file, line);
+    if (line.rfind("#?", 0) != 0) {
+        throw std::runtime_error{ std::format("Invalid .hdr header in '{}'", path) };
+    }
+    while (std::getline(file, line) && !line.empty()) {
+        if (line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe") {
+            throw std::runtime_error{ std::format("Unsupported .hdr format '{}' in '{}'", line.substr(7), path) };
+        }
+    }
+
+    std::getline(file, line);
+    std::istringstream resolution{ line };
+    std::string y_axis, x_axis;
+    resolution >> y_axis >> _height >> x_axis >> _width;
+    if (!resolution || y_axis != "-Y" || x_axis != "+X" || _width == 0 || _height == 0) {
+        throw std::runtime_error{ std::format("Unsupported .hdr resolution '{}' in '{}'", line, path) };
+    }
+
+    std::vector<uint8_t> rgbe(static_cast<size_t>(_width) * 4);
+    std::vector<uint8_t> planes(static_cast<size_t>(_width) * 4);
+    _texels.resize(static_cast<size_t>(_width) * _height);
+    for (uint32_t j = 0; j < _height; ++j) {
+        uint8_t head[4];
+        file.read(reinterpret_cast<char*>(head), 4);
+        bool rle = _width >= 8 && _width < 32768 && head[0] == 2 && head[1] == 2 && static_cast<uint32_t>((head[2] << 8) | head[3]) == _width;
+        if (!rle) {
+            // flat scanline, the 4 bytes just read are its first pixel
+            std::memcpy(rgbe.data(), head, 4);
+            file.read(reinterpret_cast<char*>(rgbe.data() + 4), rgbe.size() - 4);
+        } else {
+            // every channel is its own run length encoded plane
+            for (uint32_t c = 0; c < 4; ++c) {
+                uint8_t* plane = planes.data() + static_cast<size_t>(c) * _width;
+                uint32_t i{ 0 };
+                while (i < _width && file) {
+                    uint32_t count = static_cast<uint8_t>(file.get());
+                    if (count > 128) {
+                        count -= 128;
+                        uint8_t value = static_cast<uint8_t>(file.get());
+                        if (i + count > _width) {
+                            break;
+                        }
+                        std::fill(plane + i, plane + i + count, value);
+                    } else {
+                        if (count == 0 || i + count > _width) {
+                            break;
+                        }
+                        file.read(reinterpret_cast<char*>(plane + i), count);
+                    }
+                    i += count;
+                }
+                if (i != _width) {
+                    throw std::runtime_error{ std::format("Corrupt .hdr scanline {} in '{}'", j, path) };
+                }
+            }
+            for (uint32_t i = 0; i < _width; ++i) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    rgbe[4 * i + c] = planes[static_cast<size_t>(c) * _width + i];
+                }
+            }
+        }
+        if (!file) {
+            throw std::runtime_error{ std::format("Truncated .hdr raster in '{}'", path) };
+        }
+
+        for (uint32_t i = 0; i < _width; ++i) {
+            const uint8_t* px = &rgbe[4 * i];
+            float f = px[3] == 0 ? 0.f : std::ldexp(1.f, static_cast<int>(px[3]) - (128 + 8));
+            _texels[static_cast<size_t>(j) * _width + i] = Color(px[0] * f, px[1] * f, px[2] * f);
+        }
+    }
+}
+
+void EnvironmentMap::_build_table() {
+    /**
+     * @brief: texel weights for the importance sampling, the rows near
+     * the poles cover a smaller solid angle
+     */
+    std::vector<float> weights(_texels.size());
+    for (uint32_t j = 0; j < _height; ++j) {
+        float sin_theta = std::sin(std::numbers::pi_v<float> * (j + 0.5f) / _height);
+        for (uint32_t i = 0; i < _width; ++i) {
+            size_t idx = static_cast<size_t>(j) * _width + i;
+            weights[idx] = luminance(_texels[idx]) * sin_theta;
+        }
+    }
+
+    _table = AliasTable{ weights };
+}
+
+uint32_t EnvironmentMap::_texel(const Vec3f& dir, float& sin_theta) const {
+    /**
+     * @brief: texel seen along dir, u grows with the angle from -z
+     * towards +x and v from +y down to -y
+     */
+    Vec3f d = unit_vector(dir);
+    float cos_theta = std::clamp(d.y(), -1.f, 1.f);
+    sin_theta = std::sqrt(std::max(0.f, 1.f - cos_theta * cos_theta));
+    float u = 0.5f + std::atan2(d.x(), -d.z()) * 0.5f * std::numbers::inv_pi_v<float>;
+    float v = std::acos(cos_theta) * std::numbers::inv_pi_v<float>;
+    uint32_t i = std::min(static_cast<uint32_t>(u * _width), _width - 1);
+    uint32_t j = std::min(static_cast<uint32_t>(v * _height), _height - 1);
+
+    return j * _width + i;
+}
+
+Color EnvironmentMap::eval(const Vec3f& dir) const {
+    float sin_theta;
+
+    return _texels[_texel(dir, sin_theta)];
+}
+
+float EnvironmentMap::pdf(const Vec3f& dir) const {
+    /**
+     * @brief: solid angle density sample() gives to dir, the uv density
+     * of its texel over the 2 pi^2 sin(theta) jacobian of the mapping
+     */
+    float sin_theta;
+    uint32_t texel = _texel(dir, sin_theta);
+    if (sin_theta <= 0.f) {
+        return 0.f;
+    }
+
+    constexpr float two_pi_sq = 2.f * std::numbers::pi_v<float> * std::numbers::pi_v<float>;
+
+    return _table.pdf(texel) * _width * _height / (two_pi_sq * sin_theta);
+}
+
+env_sample_t EnvironmentMap::sample(float u_texel, sample_2d_t u_point) const {
+    uint32_t texel = _table.sample(u_texel);
+    float u = (texel % _width + u_point.x) / _width;
+    float v = (texel / _width + u_point.y) / _height;
+    float phi = (u - 0.5f) * 2.f * std::numbers::pi_v<float>;
+    float theta = v * std::numbers::pi_v<float>;
+    float sin_theta = std::sin(theta);
+
+    env_sample_t s;
+    s.dir = Vec3f(sin_theta * std::sin(phi), std::cos(theta), -sin_theta * std::cos(phi));
+    // looked up again from the direction, so that both match eval() and pdf() near the texel edges
+    s.radiance = eval(s.dir);
+    s.pdf = pdf(s.dir);
+
+    return s;
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <cmath>
+#include <algorithm>
+
+#include "framebuffer.h"
+#include "interval.h"
+
+float AccumBuffer::error(uint32_t i, uint32_t j) const {
+    /**
+     * @brief: standard error of the pixel's mean luminance, carried
+     * through the gamma 2 display curve (d sqrt(L) = dL / (2 sqrt(L)))
+     * so that one threshold fits dark and bright pixels
+     */
+    size_t p = _idx(i, j);
+    uint32_t n = _samples[p];
+    if (n < 2) {
+        return inf;
+    }
+
+    const float* px = &_rgb[3 * p];
+    float mean = luminance(Color(px[0], px[1], px[2])) / n;
+    float var = std::max(0.f, (_lum_sq[p] - n * mean * mean) / (n - 1));
+    float std_err = std::sqrt(var / n);
+
+    return std_err / (2.f * std::sqrt(std::max(mean, 1e-4f)));
+}
+
+uint32_t AccumBuffer::update_active(uint32_t max_samples, uint32_t min_samples, float threshold) {
+    /**
+     * @brief: marks the pixels the next pass samples and returns how many
+     * @details: a pixel is done at max_samples or, with a threshold > 0,
+     * once it has min_samples and no pixel of its 3x3 neighbourhood has
+     * a larger error. The neighbourhood catches the silhouette pixels
+     * whose first samples all happened to land on the same side. Only
+     * the pixels sampled by the last pass changed, so the errors of the
+     * others are reused and the pixels with none of them around stay done
+     */
+    auto neighbourhood = [&](uint32_t i, uint32_t j, auto&& f) {
+        for (uint32_t nj = (j > 0 ? j - 1 : j); nj <= std::min(j + 1, _height - 1); ++nj) {
+            for (uint32_t ni = (i > 0 ? i - 1 : i); ni <= std::min(i + 1, _width - 1); ++ni) {
+                f(_idx(ni, nj));
+            }
+        }
+    };
+
+    if (threshold > 0.f) {
+        _errors.resize(_samples.size(), inf);
+        for (uint32_t j = 0; j < _height; ++j) {
+            for (uint32_t i = 0; i < _width; ++i) {
+                if (_active[_idx(i, j)]) {
+                    _errors[_idx(i, j)] = error(i, j);
+                }
+            }
+        }
+    }
+
+    _next_active.resize(_active.size());
+    uint32_t n_active{ 0 };
+    for (uint32_t j = 0; j < _height; ++j) {
+        for (uint32_t i = 0; i < _width; ++i) {
+            size_t p = _idx(i, j);
+            bool touched{ false };
+            neighbourhood(i, j, [&](size_t q) { touched |= _active[q] != 0; });
+
+            bool active = touched && _samples[p] < max_samples;
+            if (active && threshold > 0.f && _samples[p] >= min_samples) {
+                float err{ 0.f };
+                neighbourhood(i, j, [&](size_t q) { err = std::max(err, _errors[q]); });
+                active = err > threshold;
+            }
+
+            _next_active[p] = active;
+            n_active += active;
+        }
+    }
+
+    _active.swap(_next_active);
+
+    return n_active;
+}
+
+uint64_t AccumBuffer::total_samples() const {
+    uint64_t total{ 0 };
+    for (auto s : _samples) {
+        total += s;
+    }
+
+    return total;
+}
+
+bool AccumBuffer::complete(const tile_t& tile, uint32_t max_samples) const {
+    /**
+     * @brief: true once every pixel of tile has max_samples, no later
+     * pass can change it then
+     */
+    for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+        for (uint32_t i = tile.x0; i < tile.x1; ++i) {
+            if (_samples[_idx(i, j)] < max_samples) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+Framebuffer::Framebuffer(uint32_t width, uint32_t height, uint32_t tile_size)
+: _width(width), _height(height), _tile_size(std::max(1u, tile_size))
+{
+    _pitch = (width + _line_px - 1) / _line_px * _line_px;
+    _tiles_x = (width + _tile_size - 1) / _tile_size;
+    uint32_t tiles_y = (height + _tile_size - 1) / _tile_size;
+    _dirty = std::vector<std::atomic<uint8_t>>(_tiles_x * tiles_y);
+    _published = std::make_unique<MpscRingBuffer<uint32_t>>(_dirty.size());
+
+    size_t bytes = std::max<size_t>(64, static_cast<size_t>(_pitch) * height * sizeof(uint32_t));
+    _pixels.reset(static_cast<uint32_t*>(std::aligned_alloc(64, bytes)));
+    if (!_pixels) {
+        throw std::bad_alloc{};
+    }
+    std::fill(_pixels.get(), _pixels.get() + bytes / sizeof(uint32_t), 0u);
+}
\ No newline at end of file
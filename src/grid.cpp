@@ -1,102 +1,294 @@
 #include <cmath>
 #include <algorithm>
 #include <format>
+#include <bit>
+#include <cassert>
 
 #include "grid.h"
 
-bool Cell::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec, Grid& g) const {
-    HitRecord temp_rec;
+template<bool any_hit>
+bool Grid::_hit_cell(uint32_t cell_idx, const simd_ray_t& ray, float t_min, grid_traversal_t& trav, intersection_t& closest) const {
+    /**
+     * @brief: tests the cell triangles not tested yet by the ray, gathered
+     * in blocks for the simd kernel, and replaces closest when a nearer
+     * hit is found, or returns on the first hit when any_hit is set
+     * @details: a triangle straddling several cells is tested only in the
+     * first one the ray visits, its outcome can't change later on since a
+     * hit is kept by the caller until a closer one is found. The mailbox is
+     * direct mapped, a triangle evicted by a colliding id is just tested again
+     */
     bool hit_anything{ false };
-    float closest_so_far{ ray_t.max() };
-    for (const auto& tri : _triangles) {
-        g._logger->add_ray_tri_int();
-        if (tri.hit(r_in, Interval{ ray_t.min(), closest_so_far}, temp_rec) && temp_rec.get_t() < closest_so_far) {
-            g._logger->add_true_ray_tri_int();
+    uint32_t lanes{ 0 };
+    auto test_block = [&]() {
+        _logger->add_ray_tri_int(lanes);
+        uint32_t active{ (1u << lanes) - 1 };
+        lanes = 0;
+        if constexpr (any_hit) {
+            hit_anything = TriBlocks::occluded(trav.block, ray, t_min, closest.t, active);
+        } else if (uint32_t hits = TriBlocks::hit(trav.block, ray, t_min, active, closest)) {
+            _logger->add_true_ray_tri_int(std::popcount(hits));
             hit_anything = true;
-            closest_so_far = temp_rec.get_t();
-            hitrec = temp_rec;
-            temp_rec = HitRecord();
         }
+
+        return hit_anything;
+    };
+
+    for (uint32_t i = _cell_offsets[cell_idx]; i < _cell_offsets[cell_idx + 1]; ++i) {
+        uint32_t tri_idx{ _cell_tris[i] };
+        uint32_t& slot{ trav.mailbox[tri_idx & (grid_traversal_t::mailbox_size - 1)] };
+        if (slot == tri_idx) {
+            _logger->add_avoided_ray_tri_int();
+            continue;
+        }
+
+        slot = tri_idx;
+        TriBlocks::set_lane(trav.block, lanes++, _triangles[tri_idx], tri_idx);
+        if (lanes == Simd::width && test_block() && any_hit) {
+            return true;
+        }
+    }
+
+    if (lanes > 0) {
+        test_block();
     }
-    
+
     return hit_anything;
-}                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                          
+}
 
-bool Grid::_dda(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) {
+void Grid::_init_traversal(const Ray& r_in, float t_entry, grid_traversal_t& trav) const {
     /**
-     * @brief: digital differential analyser algorithm to compute
-     * ray path and intersections through the grid
+     * @brief: locates the cell where the ray enters the grid and
+     * the ray parameters at which it crosses the next cell boundaries
      */
     Vec3f ray_dir{ r_in.direction() };
     Vec3f ray_inv_dir{ r_in.inv_dir() };
     Vec3f ray_origin{ r_in.origin() };
-    float t[3]{};
-    float dt[3]{};
-    int step[3]{};
-    int exit[3]{};
-
-    // compute ray path through the grid
     for (uint32_t i = 0; i < 3; ++i) {
-        float ray_start_cell = ((ray_origin[i] + ray_dir[i] * hitrec.get_t()) - _bbox.bounds()[0][i]);
-        _cell_index[i] = std::clamp<uint32_t>(std::floor(ray_start_cell / _cellsize[i]), 0, _n[i] - 1);
+        float ray_start_cell = ((ray_origin[i] + ray_dir[i] * t_entry) - _bbox.bounds()[0][i]);
+        trav.cell_index[i] = std::clamp<int32_t>(std::floor(ray_start_cell / _cellsize[i]), 0, _n[i] - 1);
         if (ray_dir[i] < 0) {
-            dt[i] = -_cellsize[i] * ray_inv_dir[i];
-            t[i] = hitrec.get_t() + (_cell_index[i] * _cellsize[i] - ray_start_cell) * ray_inv_dir[i];
-            exit[i] = -1;
-            step[i] = -1;
+            trav.t_delta[i] = -_cellsize[i] * ray_inv_dir[i];
+            trav.t_max[i] = t_entry + (trav.cell_index[i] * _cellsize[i] - ray_start_cell) * ray_inv_dir[i];
+            trav.exit[i] = -1;
+            trav.step[i] = -1;
         } else {
-            dt[i] = _cellsize[i] * ray_inv_dir[i];
-            t[i] = hitrec.get_t() + ((_cell_index[i] + 1) * _cellsize[i] - ray_start_cell) * ray_inv_dir[i];
-            exit[i] = static_cast<int32_t>(_n[i]);
-            step[i] = 1;
+            trav.t_delta[i] = _cellsize[i] * ray_inv_dir[i];
+            trav.t_max[i] = t_entry + ((trav.cell_index[i] + 1) * _cellsize[i] - ray_start_cell) * ray_inv_dir[i];
+            trav.exit[i] = static_cast<int32_t>(_n[i]);
+            trav.step[i] = 1;
         }
     }
 
+    std::fill(trav.mailbox, trav.mailbox + grid_traversal_t::mailbox_size, UINT32_MAX);
+    TriBlocks::clear_lanes(trav.block, 0);
+}
+
+template<bool any_hit>
+bool Grid::_dda(const Ray& r_in, const Interval& ray_t, float t_entry, intersection_t& isect) const {
+    /**
+     * @brief: digital differential analyser algorithm to compute
+     * ray path and intersections through the grid
+     * @details: the traversal state is local, so the same grid can
+     * be traversed by any number of threads at once. With any_hit the
+     * traversal ends on the first hit found, wherever it lies in ray_t,
+     * and isect is left untouched
+     */
+    grid_traversal_t trav;
+    _init_traversal(r_in, t_entry, trav);
+
     // check if the ray hits a triangle in the cells traversed by the ray
+    // a hit found past the current cell is kept, a later cell
+    // can only replace it with a closer one
+    simd_ray_t ray{ TriBlocks::broadcast(r_in) };
+    intersection_t closest;
+    closest.t = ray_t.max();
     bool hit{ false };
-    float closest_so_far{ ray_t.max() };
     while (true) {
-        uint32_t cell_idx{ std::clamp<uint32_t>(_cell_index[0] + _cell_index[1] * _n[0] + _cell_index[2] * _n[0] * _n[1], 0, _cells.size() - 1) };
-        hit = _cells[cell_idx].hit(r_in, ray_t, hitrec, *this);
-        auto min_idx = static_cast<uint32_t>(std::distance(t, std::min_element(t, t + 3)));
-        if (hit && hitrec.get_t() < t[min_idx]) {
+        uint32_t cell_idx{ std::clamp<uint32_t>(trav.cell_index[0] + trav.cell_index[1] * _n[0] + trav.cell_index[2] * _n[0] * _n[1], 0, _n[0] * _n[1] * _n[2] - 1) };
+        hit |= _hit_cell<any_hit>(cell_idx, ray, ray_t.min(), trav, closest);
+        if (any_hit && hit) {
+            return true;
+        }
+
+        auto min_idx = static_cast<uint32_t>(std::distance(trav.t_max, std::min_element(trav.t_max, trav.t_max + 3)));
+        if (hit && closest.t < trav.t_max[min_idx]) {
             break;
         }
 
-        _cell_index[min_idx] += step[min_idx];
-        if (_cell_index[min_idx] == exit[min_idx]) {
+        trav.cell_index[min_idx] += trav.step[min_idx];
+        if (trav.cell_index[min_idx] == trav.exit[min_idx]) {
             break;
         }
         
-        t[min_idx] += dt[min_idx];
+        trav.t_max[min_idx] += trav.t_delta[min_idx];
+    }
+
+    if (hit && !any_hit) {
+        isect = closest;
     }
 
     return hit;
 } 
 
+bool Grid::_init_packet_traversal(const ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const {
+    /**
+     * @brief: picks the main axis of the packet, the one its rays are
+     * closest to, and the frustum of the active rays
+     * @return: false if the rays do not all advance the same way along
+     * it, or some ray runs almost parallel to the slices
+     */
+    float sum[3]{};
+    for (uint64_t m = active; m != 0; m &= m - 1) {
+        uint32_t k = std::countr_zero(m);
+        for (uint32_t a = 0; a < 3; ++a) {
+            sum[a] += packet.dir[a][k];
+        }
+    }
+
+    auto main = static_cast<uint32_t>(std::distance(sum, std::max_element(sum, sum + 3, [](float x, float y) { return std::fabs(x) < std::fabs(y); })));
+    trav.axis[0] = main;
+    trav.axis[1] = (main + 1) % 3;
+    trav.axis[2] = (main + 2) % 3;
+    for (uint64_t m = active; m != 0; m &= m - 1) {
+        uint32_t k = std::countr_zero(m);
+        float d = packet.dir[main][k];
+        if (d * sum[main] <= 0.f || std::fabs(d) < 1e-3f) {
+            return false;
+        }
+        trav.inv_main_dir[k] = 1.f / std::fabs(d);
+    }
+
+    std::fill(trav.mailbox, trav.mailbox + grid_packet_traversal_t::mailbox_size, UINT32_MAX);
+    _packet_frustum(packet, active, trav);
+
+    return true;
+}
+
+void Grid::_packet_frustum(const ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const {
+    /**
+     * @brief: range of the slopes of the active rays on the slice axes,
+     * the rays share their origin so the range bounds them all
+     */
+    for (uint32_t i = 0; i < 2; ++i) {
+        trav.slope_min[i] = inf;
+        trav.slope_max[i] = -inf;
+    }
+
+    for (uint64_t m = active; m != 0; m &= m - 1) {
+        uint32_t k = std::countr_zero(m);
+        for (uint32_t i = 0; i < 2; ++i) {
+            float slope = packet.dir[trav.axis[i + 1]][k] * trav.inv_main_dir[k];
+            trav.slope_min[i] = std::min(trav.slope_min[i], slope);
+            trav.slope_max[i] = std::max(trav.slope_max[i], slope);
+        }
+    }
+}
+
+uint64_t Grid::_hit_cell(uint32_t cell_idx, ray_packet_t& packet, uint64_t active, grid_packet_traversal_t& trav) const {
+    /**
+     * @brief: tests the cell triangles not tested yet by the packet
+     * against all of its active rays, a simd chunk of rays at a time
+     * @return: bitmask of the rays whose closest hit was replaced
+     * @details: rays only ever leave the active set, so a triangle
+     * tested once has been tested against every ray that could still hit it
+     */
+    uint64_t hits{ 0 };
+    for (uint32_t i = _cell_offsets[cell_idx]; i < _cell_offsets[cell_idx + 1]; ++i) {
+        uint32_t tri_idx{ _cell_tris[i] };
+        uint32_t& slot{ trav.mailbox[tri_idx & (grid_packet_traversal_t::mailbox_size - 1)] };
+        if (slot == tri_idx) {
+            _logger->add_avoided_ray_tri_int();
+            continue;
+        }
+
+        slot = tri_idx;
+        simd_triangle_t tri{ RayPackets::broadcast(_triangles[tri_idx]) };
+        for (uint32_t c = 0; c * Simd::width < packet.size; ++c) {
+            uint32_t lanes{ RayPackets::chunk_rays(active, c) };
+            if (lanes == 0) {
+                continue;
+            }
+
+            _logger->add_ray_tri_int(std::popcount(lanes));
+            if (uint32_t chunk_hits = RayPackets::hit(packet, c, lanes, tri, tri_idx)) {
+                _logger->add_true_ray_tri_int(std::popcount(chunk_hits));
+                hits |= static_cast<uint64_t>(chunk_hits) << (c * Simd::width);
+            }
+        }
+    }
+
+    return hits;
+}
+
+uint64_t Grid::_hit_rays(ray_packet_t& packet, uint64_t active) const {
+    /**
+     * @brief: fallback of the packet traversal, the rays walk the grid one at a time
+     */
+    uint64_t hits{ 0 };
+    for (uint64_t m = active; m != 0; m &= m - 1) {
+        uint32_t k = std::countr_zero(m);
+        Ray r{ Vec3f(packet.o[0][k], packet.o[1][k], packet.o[2][k]), Vec3f(packet.dir[0][k], packet.dir[1][k], packet.dir[2][k]) };
+        intersection_t isect;
+        if (hit(r, Interval(packet.t_min[k], packet.t[k]), isect)) {
+            packet.t[k] = isect.t;
+            packet.u[k] = isect.u;
+            packet.v[k] = isect.v;
+            packet.prim[k] = isect.prim;
+            hits |= uint64_t{ 1 } << k;
+        }
+    }
+
+    return hits;
+}
+
+void Grid::_cell_range(const Triangle& tri, uint32_t lo[3], uint32_t hi[3]) const {
+    /**
+     * @brief: range of cells overlapped by the triangle bbox, both ends included
+     */
+    for (uint32_t i = 0; i < 3; ++i) {
+        float min = std::floor((tri.get_bbox().bounds()[0][i] - _bbox.bounds()[0][i]) / _cellsize[i]);
+        float max = std::floor((tri.get_bbox().bounds()[1][i] - _bbox.bounds()[0][i]) / _cellsize[i]);
+        lo[i] = std::clamp<int32_t>(min, 0, _n[i] - 1);
+        hi[i] = std::clamp<int32_t>(max, 0, _n[i] - 1);
+    }
+}
+
 void Grid::_insert_triangles() {
+    /**
+     * @brief: fills the cells in compressed sparse row form
+     * @details: the first pass counts the triangles per cell and turns
+     * the counts into offsets, the second pass writes every triangle
+     * index in its cells, so each cell is a contiguous range of indices
+     * into the single triangle array
+     */
+    uint32_t n_cells{ _n[0] * _n[1] * _n[2] };
+    _cell_offsets.assign(n_cells + 1, 0);
+
+    uint32_t lo[3], hi[3];
     for (const auto& tri : _triangles) {
+        _cell_range(tri, lo, hi);
+        for (uint32_t z = lo[2]; z <= hi[2]; ++z) {
+            for (uint32_t y = lo[1]; y <= hi[1]; ++y) {
+                for (uint32_t x = lo[0]; x <= hi[0]; ++x) {
+                    ++_cell_offsets[x + y * _n[0] + z * _n[0] * _n[1] + 1];
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < n_cells; ++i) {
+        _cell_offsets[i + 1] += _cell_offsets[i];
+    }
 
-        // convert to cells coordinates
-        Vec3f min{};
-        Vec3f max{};
-        for (uint32_t i = 0; i < 3; ++i) {
-            min[i] = std::floor((tri.get_bbox().bounds()[0][i] - _bbox.bounds()[0][i]) / _cellsize[i]);
-            max[i] = std::floor((tri.get_bbox().bounds()[1][i] - _bbox.bounds()[0][i]) / _cellsize[i]);
-        }
-
-        auto x_min = std::clamp<uint32_t>(min.x(), 0, _n[0] - 1);
-        auto x_max = std::clamp<uint32_t>(max.x(), 0, _n[0] - 1);
-        auto y_min = std::clamp<uint32_t>(min.y(), 0, _n[1] - 1);
-        auto y_max = std::clamp<uint32_t>(max.y(), 0, _n[1] - 1);
-        auto z_min = std::clamp<uint32_t>(min.z(), 0, _n[2] - 1);
-        auto z_max = std::clamp<uint32_t>(max.z(), 0, _n[2] - 1);
-
-        for (uint32_t z = z_min; z <= z_max; ++z) {
-            for (uint32_t y = y_min; y <= y_max; ++y) {
-                for (uint32_t x = x_min; x <= x_max; ++x) {
-                    uint32_t idx = x + y * _n[0] + z * _n[0] * _n[1];
-                    _cells[idx].push_triangle(tri);
+    // every cell is filled from its own offset on
+    std::vector<uint32_t> fill(_cell_offsets.begin(), _cell_offsets.end() - 1);
+    _cell_tris.resize(_cell_offsets.back());
+    for (uint32_t t = 0; t < _triangles.size(); ++t) {
+        _cell_range(_triangles[t], lo, hi);
+        for (uint32_t z = lo[2]; z <= hi[2]; ++z) {
+            for (uint32_t y = lo[1]; y <= hi[1]; ++y) {
+                for (uint32_t x = lo[0]; x <= hi[0]; ++x) {
+                    _cell_tris[fill[x + y * _n[0] + z * _n[0] * _n[1]]++] = t;
                 }
             }
         }
@@ -108,26 +300,128 @@ Grid::Grid(const BoundingBox& bbox, const std::vector<Triangle> tris, std::share
 {
     // heuristic grid resolution proposed in
     // https://www.researchgate.net/publication/220183660_Ray_Tracing_Animated_Scenes_Using_Coherent_Grid_Traversal
-    float cbrt{ std::cbrt(_lambda * _triangles.size() / _bbox.volume()) };
+    // padded sizes, flat meshes such as area lights have no volume otherwise
+    Vec3f size = _bbox.bounds()[1] - _bbox.bounds()[0];
+    float cbrt{ std::cbrt(_lambda * _triangles.size() / (size.x() * size.y() * size.z())) };
 
-    auto nx = static_cast<uint32_t>(std::floor(_bbox.size_x() * cbrt));
-    auto ny = static_cast<uint32_t>(std::floor(_bbox.size_y() * cbrt));
-    auto nz = static_cast<uint32_t>(std::floor(_bbox.size_z() * cbrt));
+    auto nx = static_cast<uint32_t>(std::floor(size.x() * cbrt));
+    auto ny = static_cast<uint32_t>(std::floor(size.y() * cbrt));
+    auto nz = static_cast<uint32_t>(std::floor(size.z() * cbrt));
 
     _n[0] = nx >= 1 ? nx : 1;
     _n[1] = ny >= 1 ? ny : 1;
     _n[2] = nz >= 1 ? nz : 1;
-    _cells.resize(_n[0] * _n[1] * _n[2]);
-    _cellsize = Vec3f(1.f/cbrt);
+
+    // cells span the whole (padded) bbox, so that no triangle
+    // lies beyond the last cell boundary crossed by the dda
+    for (uint32_t i = 0; i < 3; ++i) {
+        _cellsize[i] = (_bbox.bounds()[1][i] - _bbox.bounds()[0][i]) / _n[i];
+    }
     _logger->add_grid_and_cells(_n[0], _n[1], _n[2]);
 
     _insert_triangles();
 }
 
-bool Grid::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) {
-    if (!_bbox.hit(r_in, ray_t, hitrec)) {
+bool Grid::hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const {
+    float t_entry;
+    if (!_bbox.hit(r_in, ray_t, t_entry)) {
         return false;
     }
 
-    return _dda(r_in, ray_t, hitrec);
+    return _dda<false>(r_in, ray_t, t_entry, isect);
+}
+
+bool Grid::occluded(const Ray& r_in, const Interval& ray_t) const {
+    float t_entry;
+    if (!_bbox.hit(r_in, ray_t, t_entry)) {
+        return false;
+    }
+
+    intersection_t unused;
+
+    return _dda<true>(r_in, ray_t, t_entry, unused);
+}
+
+uint64_t Grid::hit(ray_packet_t& packet) const {
+    /**
+     * @brief: closest hits of a packet of rays leaving from the same
+     * origin, like the camera rays of a block of pixels
+     * @return: bitmask of the rays whose closest hit was replaced
+     * @details: coherent grid traversal (Wald et al.), the packet walks
+     * the grid a slice of cells at a time along its main axis. The frustum
+     * of the rays bounds the cells of the slice they can cross, and every
+     * triangle of those cells is tested against the whole packet. A ray is
+     * done once its closest hit lies before the far side of the slice, and
+     * the frustum shrinks to the rays left. Packets whose rays do not all
+     * advance the same way along an axis are traced a ray at a time
+     */
+    assert(packet.shared_origin);
+
+    uint64_t active{ RayPackets::hit_box(packet, _bbox.bounds()[0], _bbox.bounds()[1], RayPackets::all_rays(packet)) };
+    if (active == 0) {
+        return 0;
+    }
+
+    grid_packet_traversal_t trav;
+    if (!_init_packet_traversal(packet, active, trav)) {
+        return _hit_rays(packet, active);
+    }
+
+    // origin and planes relative to the grid corner
+    const uint32_t a{ trav.axis[0] };
+    const Vec3f origin{ packet.origin - _bbox.bounds()[0] };
+    const bool forward{ packet.dir[a][std::countr_zero(active)] > 0.f };
+    const int32_t step{ forward ? 1 : -1 };
+    const int32_t exit{ forward ? static_cast<int32_t>(_n[a]) : -1 };
+    int32_t slice{ std::clamp<int32_t>(std::floor(origin[a] / _cellsize[a]), 0, _n[a] - 1) };
+    uint64_t hits{ 0 };
+    for (; slice != exit && active != 0; slice += step) {
+        // distances from the origin to the slice sides along the main axis
+        float near_side{ (forward ? slice : slice + 1) * _cellsize[a] };
+        float far_side{ (forward ? slice + 1 : slice) * _cellsize[a] };
+        float d_near{ std::max(0.f, forward ? near_side - origin[a] : origin[a] - near_side) };
+        float d_far{ forward ? far_side - origin[a] : origin[a] - far_side };
+
+        // cells of the slice inside the frustum, widened against rounding
+        int32_t lo[2], hi[2];
+        bool inside{ true };
+        for (uint32_t i = 0; i < 2 && inside; ++i) {
+            uint32_t b{ trav.axis[i + 1] };
+            float margin{ 1e-3f * _cellsize[b] };
+            float min{ origin[b] + std::min(d_near * trav.slope_min[i], d_far * trav.slope_min[i]) - margin };
+            float max{ origin[b] + std::max(d_near * trav.slope_max[i], d_far * trav.slope_max[i]) + margin };
+            float cell_min{ std::floor(min / _cellsize[b]) };
+            float cell_max{ std::floor(max / _cellsize[b]) };
+            inside = cell_max >= 0.f && cell_min < _n[b];
+            lo[i] = static_cast<int32_t>(std::max(cell_min, 0.f));
+            hi[i] = static_cast<int32_t>(std::min(cell_max, _n[b] - 1.f));
+        }
+
+        if (inside) {
+            uint32_t cell[3];
+            cell[a] = slice;
+            for (int32_t c2 = lo[1]; c2 <= hi[1]; ++c2) {
+                cell[trav.axis[2]] = c2;
+                for (int32_t c1 = lo[0]; c1 <= hi[0]; ++c1) {
+                    cell[trav.axis[1]] = c1;
+                    hits |= _hit_cell(cell[0] + cell[1] * _n[0] + cell[2] * _n[0] * _n[1], packet, active, trav);
+                }
+            }
+        }
+
+        // a later slice can only hold hits past the closest ones found before d_far
+        uint64_t done{ 0 };
+        for (uint64_t m = active; m != 0; m &= m - 1) {
+            uint32_t k = std::countr_zero(m);
+            if (packet.t[k] < d_far * trav.inv_main_dir[k]) {
+                done |= uint64_t{ 1 } << k;
+            }
+        }
+        if (done != 0) {
+            active &= ~done;
+            _packet_frustum(packet, active, trav);
+        }
+    }
+
+    return hits;
 }
\ No newline at end of file
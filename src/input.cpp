@@ -64,6 +64,11 @@ void from_json(const njson& j, init_params_t& p) {
     } else {
         p.background = Color();
     }
+    if (j.count("environment_map") != 0) {
+        j.at("environment_map").get_to(p.environment_map);
+    } else {
+        p.environment_map = "";
+    }
     if (j.count("vfov") != 0) {
         j.at("vfov").get_to(p.vfov);
     } else {
@@ -84,11 +89,74 @@ void from_json(const njson& j, init_params_t& p) {
     } else {
         p.depth = 10;
     }
+    if (j.count("rr_depth") != 0) {
+        j.at("rr_depth").get_to(p.rr_depth);
+    } else {
+        p.rr_depth = 3;
+    }
     if (j.count("samples_per_pixel") != 0) {
         j.at("samples_per_pixel").get_to(p.samples_per_pixel);
     } else {
         p.samples_per_pixel = 10;
     }
+    if (j.count("samples_per_pass") != 0) {
+        j.at("samples_per_pass").get_to(p.samples_per_pass);
+    } else {
+        p.samples_per_pass = 0;
+    }
+    if (j.count("min_samples_per_pixel") != 0) {
+        j.at("min_samples_per_pixel").get_to(p.min_samples_per_pixel);
+    } else {
+        p.min_samples_per_pixel = 4;
+    }
+    if (j.count("adaptive_threshold") != 0) {
+        j.at("adaptive_threshold").get_to(p.adaptive_threshold);
+    } else {
+        p.adaptive_threshold = 0.f;
+    }
+    if (j.count("threads") != 0) {
+        j.at("threads").get_to(p.threads);
+    } else {
+        p.threads = 0;
+    }
+    if (j.count("tile_size") != 0) {
+        j.at("tile_size").get_to(p.tile_size);
+    } else {
+        p.tile_size = 32;
+    }
+    if (j.count("headless") != 0) {
+        j.at("headless").get_to(p.headless);
+    } else {
+        p.headless = false;
+    }
+    if (j.count("max_fps") != 0) {
+        j.at("max_fps").get_to(p.max_fps);
+    } else {
+        p.max_fps = 30;
+    }
+    if (j.count("sampler") != 0) {
+        j.at("sampler").get_to(p.sampler);
+    } else {
+        p.sampler = SamplerType::sobol;
+    }
+    if (j.count("tonemap") != 0) {
+        j.at("tonemap").get_to(p.tonemap);
+    } else {
+        p.tonemap = TonemapType::none;
+    }
+    if (j.count("engine") != 0) {
+        j.at("engine").get_to(p.engine);
+    } else {
+        p.engine = EngineType::megakernel;
+    }
+    if (j.count("packet_size") != 0) {
+        j.at("packet_size").get_to(p.packet_size);
+        if (p.packet_size != 0 && p.packet_size != 4 && p.packet_size != 8) {
+            throw std::runtime_error{ std::format("Invalid packet_size '{}', expected 0, 4 or 8", p.packet_size) };
+        }
+    } else {
+        p.packet_size = 8;
+    }
 }
 
 void from_json(const njson& j, camera_angles_t& angles) {
@@ -109,8 +177,63 @@ void from_json(const njson& j, camera_angles_t& angles) {
     }
 }
 
+void from_json(const njson& j, AccelType& accel) {
+    std::string name = j.get<std::string>();
+    to_lower(name);
+    if (name == "grid") {
+        accel = AccelType::grid;
+    } else if (name == "bvh") {
+        accel = AccelType::bvh;
+    } else {
+        throw std::runtime_error{ std::format("Invalid acceleration structure '{}', expected 'grid' or 'bvh'", name) };
+    }
+}
+
+void from_json(const njson& j, SamplerType& sampler) {
+    std::string name = j.get<std::string>();
+    to_lower(name);
+    if (name == "independent") {
+        sampler = SamplerType::independent;
+    } else if (name == "sobol") {
+        sampler = SamplerType::sobol;
+    } else if (name == "blue_noise") {
+        sampler = SamplerType::blue_noise;
+    } else {
+        throw std::runtime_error{ std::format("Invalid sampler '{}', expected 'independent', 'sobol' or 'blue_noise'", name) };
+    }
+}
+
+void from_json(const njson& j, TonemapType& tonemap) {
+    std::string name = j.get<std::string>();
+    to_lower(name);
+    if (name == "none") {
+        tonemap = TonemapType::none;
+    } else if (name == "reinhard") {
+        tonemap = TonemapType::reinhard;
+    } else if (name == "aces") {
+        tonemap = TonemapType::aces;
+    } else {
+        throw std::runtime_error{ std::format("Invalid tonemap '{}', expected 'none', 'reinhard' or 'aces'", name) };
+    }
+}
+
+void from_json(const njson& j, EngineType& engine) {
+    std::string name = j.get<std::string>();
+    to_lower(name);
+    if (name == "megakernel") {
+        engine = EngineType::megakernel;
+    } else if (name == "wavefront") {
+        engine = EngineType::wavefront;
+    } else {
+        throw std::runtime_error{ std::format("Invalid engine '{}', expected 'megakernel' or 'wavefront'", name) };
+    }
+}
+
 void from_json(const njson& j, geometry_params_t& g) {
     j.at("obj_file").get_to(g.obj_file);
+    if (j.count("accel") != 0) {
+        j.at("accel").get_to(g.accel);
+    }
     if (j.count("alpha") != 0) {
         j.at("alpha").get_to(g.alpha);
     }
@@ -137,11 +260,24 @@ init_params_t init_from_json(const std::string& datapath) {
         "lookfrom",
         "lookat",
         "background",
+        "environment_map",
         "vfov",
         "focus_dist",
         "outfile_name",
         "depth",
-        "samples_per_pixel"
+        "rr_depth",
+        "samples_per_pixel",
+        "samples_per_pass",
+        "min_samples_per_pixel",
+        "adaptive_threshold",
+        "threads",
+        "tile_size",
+        "headless",
+        "max_fps",
+        "sampler",
+        "tonemap",
+        "engine",
+        "packet_size"
     };
 
     std::ifstream file(datapath);
@@ -199,6 +335,7 @@ geometry_params_t get_geometry(njson& j) {
 std::vector<geometry_params_t> geometries_from_json(const std::string& datapath) {
     const std::set<std::string> geometry_keys{
         "obj_file",
+        "accel",
         "alpha",
         "beta",
         "gamma",
@@ -0,0 +1,116 @@
+#include <cmath>
+#include <algorithm>
+
+#include "light.h"
+#include "matrix.h"
+
+LightList::LightList(const MeshList& meshes, std::shared_ptr<const EnvironmentMap> environment)
+: _environment(environment)
+{
+    /**
+     * @brief: collects the emissive triangles of every instance, moved
+     * to world space, and builds the alias table over their power
+     * @details: meshes must have their final instance order, the light of a
+     * hit is found from its instance and triangle indices
+     */
+    std::vector<float> power;
+    _first_light.assign(meshes.num_instances(), UINT32_MAX);
+    for (uint32_t i = 0; i < meshes.num_instances(); ++i) {
+        const Instance& instance = meshes.instance(i);
+        const Mesh& mesh = instance.mesh();
+        if (!mesh.emissive()) {
+            continue;
+        }
+
+        _first_light[i] = _tris.size();
+        for (const auto& tri : mesh.get_triangles()) {
+            Vec3f v0 = mat4_vec3_prod(instance.transformation(), tri.v0().pos);
+            Vec3f v1 = mat4_vec3_prod(instance.transformation(), tri.v1().pos);
+            Vec3f v2 = mat4_vec3_prod(instance.transformation(), tri.v2().pos);
+            Vec3f n = cross(v1 - v0, v2 - v0);
+            float double_area = n.length();
+
+            // degenerate triangles stay in the list to keep the indices, they are never picked
+            emissive_triangle_t light{ v0, v1 - v0, v2 - v0, Vec3f(), 0.5f * double_area, mesh.emission() };
+            if (double_area > 0.f) {
+                light.normal = n / double_area;
+            }
+            _tris.push_back(light);
+            power.push_back(luminance(light.emission) * light.area);
+        }
+    }
+
+    if (!_tris.empty()) {
+        _table = AliasTable{ power };
+    }
+
+    if (_environment) {
+        _environment_prob = _tris.empty() ? 1.f : 0.5f;
+    }
+}
+
+float LightList::_solid_angle_pdf(uint32_t light, const Vec3f& p, const Vec3f& q) const {
+    /**
+     * @brief: density of drawing q on light as seen from p, the area
+     * density converted to solid angle
+     */
+    const emissive_triangle_t& tri = _tris[light];
+    Vec3f d = q - p;
+    float dist_sq = d.length_squared();
+    float cos_light = std::fabs(dot(tri.normal, d)) / std::sqrt(dist_sq);
+    if (cos_light <= 0.f || tri.area <= 0.f) {
+        return 0.f;
+    }
+
+    return (1.f - _environment_prob) * _table.pdf(light) * dist_sq / (tri.area * cos_light);
+}
+
+light_sample_t LightList::sample(const Vec3f& p, float u_light, sample_2d_t u_point) const {
+    /**
+     * @brief: picks a light with u_light and a uniform point on it with
+     * u_point, for the shaded point p
+     */
+    light_sample_t s;
+    if (u_light < _environment_prob) {
+        env_sample_t env = _environment->sample(u_light / _environment_prob, u_point);
+        s.wi = env.dir;
+        s.emission = env.radiance;
+        s.pdf = _environment_prob * env.pdf;
+
+        return s;
+    }
+
+    u_light = std::min((u_light - _environment_prob) / (1.f - _environment_prob), 0x1.fffffep-1f);
+    uint32_t light = _table.sample(u_light);
+    const emissive_triangle_t& tri = _tris[light];
+
+    // square to triangle warp, folds the upper half of the square back
+    float b1 = u_point.x;
+    float b2 = u_point.y;
+    if (b1 + b2 > 1.f) {
+        b1 = 1.f - b1;
+        b2 = 1.f - b2;
+    }
+
+    Vec3f q = tri.v0 + b1 * tri.e1 + b2 * tri.e2;
+    Vec3f to_light = q - p;
+    s.dist = to_light.length();
+    s.wi = to_light / s.dist;
+    s.emission = tri.emission;
+    s.pdf = _solid_angle_pdf(light, p, q);
+
+    return s;
+}
+
+float LightList::pdf(const Vec3f& p, const intersection_t& isect, const Vec3f& q) const {
+    /**
+     * @brief: density sample() would have given to q, the point hit from p
+     * by a bsdf sampled ray, 0 if the hit triangle does not emit
+     */
+    uint32_t first = _first_light[isect.instance];
+    if (first == UINT32_MAX) {
+        return 0.f;
+    }
+
+    return _solid_angle_pdf(first + isect.prim, p, q);
+}
\ No newline at end of file
@@ -1,19 +1,51 @@
 #include <format>
 #include <iostream>
 #include <fstream>
+#include <atomic>
 
 #include "logger.h"
 #include "utils.h"
 
+static std::atomic<uint64_t> next_logger_id{ 1 };
+
 Logger::Logger(const std::string& outdir, const std::string& filename) {
     _img_file = Utils::strip_extenstions(filename) + ".png";
     _log_file = Utils::strip_extenstions(filename) + "_log.txt";
     _outdir = outdir;
+    _id = next_logger_id++;
+}
+
+ray_counters_t& Logger::_register_thread() {
+    std::lock_guard<std::mutex> lk(_counters_mut);
+    _counters.push_back(std::make_unique<ray_counters_t>());
+
+    return *_counters.back();
+}
+
+ray_counters_t Logger::counters() const {
+    /**
+     * @details: meant to be called once the render threads are done
+     */
+    ray_counters_t sum;
+    for (const auto& c : _counters) {
+        sum.rays += c->rays;
+        sum.total_ray_tri_intersections += c->total_ray_tri_intersections;
+        sum.true_ray_tri_intersections += c->true_ray_tri_intersections;
+        sum.avoided_ray_tri_intersections += c->avoided_ray_tri_intersections;
+    }
+
+    return sum;
 }
 
 void Logger::_print_log(std::ostream& out) const {
+    ray_counters_t counters = this->counters();
+
     out << std::format("Rendering log for image '{}'\n\n", _img_file);
     out << std::format("Total mesh objects: {}\n", _mesh_objects);
+    out << std::format("Total mesh instances: {}\n", _instances);
+    if (!_top_level.empty()) {
+        out << std::format("Top level BVH: nodes = {}, leaves = {}, depth = {}\n", _top_level[0], _top_level[1], _top_level[2]);
+    }
     out << std::format("Total grids: {}\n", _grids.size());
     for (uint32_t i = 0; i < _grids.size(); ++i) {
         uint32_t nx = _grids[i][0];
@@ -22,14 +54,32 @@ void Logger::_print_log(std::ostream& out) const {
         out << std::format("Grid {}: nx = {}, ny = {}, nz = {}, total cells: {}\n", i, nx, ny, nz, nx * ny * nz);
     }
 
+    out << std::format("Total BVHs: {}\n", _bvhs.size());
+    for (uint32_t i = 0; i < _bvhs.size(); ++i) {
+        out << std::format("BVH {}: nodes = {}, leaves = {}, depth = {}\n", i, _bvhs[i][0], _bvhs[i][1], _bvhs[i][2]);
+    }
+
     out << std::format("Total triangles: {}\n", _triangles);
-    out << std::format("Total Ray-Triangle intersections tested: {}\n", _total_ray_tri_intersections);
-    out << std::format("Succesfull Ray-Triangle hits: {}\n", _true_ray_tri_intersections);
+    out << std::format("Emissive triangles: {}\n", _lights);
+    out << std::format("Total Ray-Triangle intersections tested: {}\n", counters.total_ray_tri_intersections);
+    out << std::format("Succesfull Ray-Triangle hits: {}\n", counters.true_ray_tri_intersections);
+    out << std::format("Ray-Triangle intersections avoided by mailboxing: {}\n", counters.avoided_ray_tri_intersections);
 
-    auto hitrate = static_cast<float>(_true_ray_tri_intersections) / _total_ray_tri_intersections;
+    auto hitrate = static_cast<float>(counters.true_ray_tri_intersections) / counters.total_ray_tri_intersections;
     out << std::format("Hit rate: {:.2f}%\n", hitrate * 100);
+
+    auto tests_per_ray = static_cast<float>(counters.total_ray_tri_intersections) / counters.rays;
+    out << std::format("Traced rays: {}\n", counters.rays);
+    out << std::format("Ray-Triangle intersections tested per ray: {:.2f}\n", tests_per_ray);
+    out << std::format("Render threads: {}, tiles: {}\n", _render_threads, _tiles);
+    auto avg_spp = static_cast<float>(_samples) / _pixels;
+    out << std::format("Camera samples: {}, per pixel: {:.2f}\n", _samples, avg_spp);
+    out << std::format("Progressive passes: {}, first pass time: {} [s]\n", _passes, _first_pass_time);
     out << std::format("Rendering time: {} [s]\n", _render_time);
-}   
+    if (_render_time > 0.f) {
+        out << std::format("Throughput: {:.2f} Mrays/s, {:.2f} Msamples/s\n", counters.rays / _render_time * 1e-6f, _samples / _render_time * 1e-6f);
+    }
+}
 
 void Logger::log() const {
     _print_log(std::cout);
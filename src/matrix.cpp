@@ -83,8 +83,10 @@ Mat4 frame_transformation(float a, float b, float c, float s, const Vec3f& t) {
 
 Mat4 frame_transformation_inv(float a, float b, float c, float s, const Vec3f& t) {
     /**
-     * @brief: "inverse" frame transformation, to be used for normals, the 
-     * transposition of the rotation matrix is done manually inplace
+     * @brief: inverse of frame_transformation, the transposition of 
+     * the rotation matrix is done manually inplace
+     * @details: p = s * R * p' + t is inverted as p' = R^T * (p - t) / s,
+     * normals go through the transpose of its linear part (see mat4_normal_prod)
      * @param s: the direct scale factor, to be inverted later
      */
     Mat3 rot = frame_rotation(a,b,c);
@@ -93,8 +95,13 @@ Mat4 frame_transformation_inv(float a, float b, float c, float s, const Vec3f& t
         std::array{ s_inv * rot[0][0], s_inv * rot[1][0], s_inv * rot[2][0], 0.0f },
         std::array{ s_inv * rot[0][1], s_inv * rot[1][1], s_inv * rot[2][1], 0.0f },
         std::array{ s_inv * rot[0][2], s_inv * rot[1][2], s_inv * rot[2][2], 0.0f },
-        std::array{ -t.x(), -t.y(), -t.z(), 1.f }
+        std::array{ 0.0f, 0.0f, 0.0f, 1.f }
     };
 
+    Vec3f t_inv = -mat4_dir_prod(m, t);
+    m[3][0] = t_inv.x();
+    m[3][1] = t_inv.y();
+    m[3][2] = t_inv.z();
+
     return m;
 }
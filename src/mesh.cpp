@@ -1,20 +1,20 @@
 #include <memory>
 #include <cassert>
 #include <algorithm>
+#include <format>
 
 #include "mesh.h"
 #include "utils.h"
 
-Mesh::Mesh(const objl::Mesh& mesh, Mat4&& m, Mat4&& m_inv, MeshList& list) {
+Mesh::Mesh(const objl::Mesh& mesh, AccelType accel, std::shared_ptr<Logger> logger) {
     Vec3f pmin{ inf };
     Vec3f pmax{ -inf };
 
-    _transf = std::move(m);
-    _transf_inv = std::move(m_inv);
     float r = mesh.MeshMaterial.Ka.X;
     float g = mesh.MeshMaterial.Ka.Y;
     float b = mesh.MeshMaterial.Ka.Z;
     _color = Color(r,g,b);
+    _emission = Color(mesh.MeshMaterial.Ke);
     
     assert(mesh.Vertices.size() % 3 == 0);
 
@@ -29,13 +29,6 @@ Mesh::Mesh(const objl::Mesh& mesh, Mat4&& m, Mat4&& m_inv, MeshList& list) {
         auto v2 = mesh.Vertices[mesh.Indices[i + 2]];
         auto v2_pos = Vec3f(v2.Position);
         auto v2_normal = Vec3f(v2.Normal);
-        
-        mat4_vec3_prod_inplace(_transf, v0_pos);
-        mat4_vec3_prod_inplace(_transf, v1_pos);
-        mat4_vec3_prod_inplace(_transf, v2_pos);
-        mat4_vec3_prod_inplace(_transf_inv, v0_normal);
-        mat4_vec3_prod_inplace(_transf_inv, v1_normal);
-        mat4_vec3_prod_inplace(_transf_inv, v2_normal);
 
         Utils::set_pmin_pmax(pmin, pmax, v0_pos);
         Utils::set_pmin_pmax(pmin, pmax, v1_pos);
@@ -49,16 +42,169 @@ Mesh::Mesh(const objl::Mesh& mesh, Mat4&& m, Mat4&& m_inv, MeshList& list) {
         );
     }
 
-    _grid = Grid{ BoundingBox(pmin, pmax), _triangles, list._logger };
+    switch (accel) {
+        case AccelType::grid:
+            _accel = Grid{ BoundingBox(pmin, pmax), _triangles, logger };
+            break;
+        case AccelType::bvh:
+            _accel = BVH{ BoundingBox(pmin, pmax), _triangles, logger };
+            break;
+    }
+}
+
+const BoundingBox& Mesh::bbox() const {
+
+    return std::visit([](const auto& accel) -> const BoundingBox& { return accel.bbox(); }, _accel);
+}
+
+bool Mesh::hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const {
+
+    return std::visit([&](const auto& accel) { return accel.hit(r_in, ray_t, isect); }, _accel);
+}
+
+bool Mesh::occluded(const Ray& r_in, const Interval& ray_t) const {
+
+    return std::visit([&](const auto& accel) { return accel.occluded(r_in, ray_t); }, _accel);
 }
 
-bool Mesh::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const {
+Instance::Instance(std::shared_ptr<const Mesh> mesh, Mat4&& m, Mat4&& m_inv)
+: _mesh(mesh), _transf(std::move(m)), _transf_inv(std::move(m_inv))
+{
+    // world bbox enclosing the transformed corners of the object space one
+    Vec3f pmin{ inf };
+    Vec3f pmax{ -inf };
+    const auto& bounds = _mesh->bbox().bounds();
+    for (uint32_t corner = 0; corner < 8; ++corner) {
+        Vec3f p{ bounds[corner & 1].x(), bounds[(corner >> 1) & 1].y(), bounds[(corner >> 2) & 1].z() };
+        Utils::set_pmin_pmax(pmin, pmax, mat4_vec3_prod(_transf, p));
+    }
 
-    return _grid.hit(r_in, ray_t, hitrec);
+    _bbox = BoundingBox(pmin, pmax);
+}
+
+bool Instance::hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const {
+    /**
+     * @details: the object space ray direction is normalized again, so ray
+     * parameters are rescaled by the object space length of a unit step,
+     * baricentric coords are the same in both spaces
+     */
+    Vec3f dir = mat4_dir_prod(_transf_inv, r_in.direction());
+    float dir_len = dir.length();
+    Ray r_obj{ mat4_vec3_prod(_transf_inv, r_in.origin()), dir };
+    if (!_mesh->hit(r_obj, Interval(ray_t.min() * dir_len, ray_t.max() * dir_len), isect)) {
+        return false;
+    }
+
+    isect.t /= dir_len;
+
+    return true;
+}
+
+bool Instance::occluded(const Ray& r_in, const Interval& ray_t) const {
+    Vec3f dir = mat4_dir_prod(_transf_inv, r_in.direction());
+    float dir_len = dir.length();
+    Ray r_obj{ mat4_vec3_prod(_transf_inv, r_in.origin()), dir };
+
+    return _mesh->occluded(r_obj, Interval(ray_t.min() * dir_len, ray_t.max() * dir_len));
+}
+
+void Instance::hit(ray_packet_t& packet, uint32_t instance_idx, uint64_t rays) const {
+    /**
+     * @brief: packet version of hit, for the rays in the rays bitmask
+     * @details: rays sharing their origin walk a Grid together, they
+     * still share it in object space and their directions and intervals
+     * are rescaled one by one as in hit. Any other packet goes down to
+     * the mesh a ray at a time, with the same arithmetic as hit
+     */
+    auto replace = [&](uint32_t k, float t, const intersection_t& isect) {
+        if (t < packet.t[k]) {
+            packet.t[k] = t;
+            packet.u[k] = isect.u;
+            packet.v[k] = isect.v;
+            packet.prim[k] = isect.prim;
+            packet.instance[k] = instance_idx;
+        }
+    };
+
+    if (!_mesh->grid() || !packet.shared_origin) {
+        for (uint64_t m = rays; m != 0; m &= m - 1) {
+            uint32_t k = std::countr_zero(m);
+            Vec3f dir = mat4_dir_prod(_transf_inv, Vec3f(packet.dir[0][k], packet.dir[1][k], packet.dir[2][k]));
+            float dir_len = dir.length();
+            Ray r_obj{ mat4_vec3_prod(_transf_inv, Vec3f(packet.o[0][k], packet.o[1][k], packet.o[2][k])), dir };
+            intersection_t isect;
+            if (_mesh->hit(r_obj, Interval(packet.t_min[k] * dir_len, packet.t[k] * dir_len), isect)) {
+                replace(k, isect.t / dir_len, isect);
+            }
+        }
+
+        return;
+    }
+
+    ray_packet_t r_obj;
+    float dir_len[ray_packet_t::max_size];
+    const Vec3f origin = mat4_vec3_prod(_transf_inv, packet.origin);
+    RayPackets::start(r_obj);
+    for (uint32_t k = 0; k < packet.size; ++k) {
+        Vec3f dir = mat4_dir_prod(_transf_inv, Vec3f(packet.dir[0][k], packet.dir[1][k], packet.dir[2][k]));
+        dir_len[k] = dir.length();
+        // the rays left out get an empty interval
+        float t_max = ((rays >> k) & 1) ? packet.t[k] * dir_len[k] : 0.f;
+        RayPackets::push(r_obj, Ray{ origin, dir }, packet.t_min[k] * dir_len[k], t_max);
+    }
+    RayPackets::close(r_obj);
+
+    for (uint64_t m = _mesh->grid()->hit(r_obj); m != 0; m &= m - 1) {
+        uint32_t k = std::countr_zero(m);
+        replace(k, r_obj.t[k] / dir_len[k], RayPackets::intersection(r_obj, k));
+    }
+}
+
+HitRecord Instance::hit_record(const Ray& r_in, const intersection_t& isect) const {
+    /**
+     * @brief: world space hit point, normal and color of the closest hit,
+     * evaluated once per traced ray after the traversal
+     */
+    const Triangle& tri = _mesh->get_triangles()[isect.prim];
+    Vec3f normal = unit_vector(mat4_normal_prod(_transf_inv, tri.normal_at(isect.u, isect.v)));
+
+    HitRecord rec{ r_in.at(isect.t), normal, isect.t };
+    rec.set_u(isect.u);
+    rec.set_v(isect.v);
+    rec.set_color(tri.get_color());
+    rec.set_emission(_mesh->emission());
+
+    return rec;
 }
 
 void MeshList::add(const objl::Loader& loader, const geometry_params_t& g) {
-    for (const auto& mesh : loader.LoadedMeshes) {
+    /**
+     * @brief: builds the object space meshes of loader, unless the same OBJ
+     * file was already added, and places them as described by g
+     */
+    auto& prototype = _prototypes[{ g.obj_file, g.accel }];
+    if (prototype.empty()) {
+        for (const auto& mesh : loader.LoadedMeshes) {
+            _logger->add_mesh_obj();
+            auto m = std::make_shared<const Mesh>(mesh, g.accel, _logger);
+            _logger->add_tris(m->get_triangles().size());
+            prototype.push_back(std::move(m));
+        }
+    }
+
+    add(g);
+}
+
+void MeshList::add(const geometry_params_t& g) {
+    /**
+     * @brief: places a new instance of the already loaded OBJ file g.obj_file
+     */
+    auto it = _prototypes.find({ g.obj_file, g.accel });
+    if (it == _prototypes.end()) {
+        throw std::runtime_error{ std::format("mesh '{}' placed before being loaded", g.obj_file) };
+    }
+
+    for (const auto& mesh : it->second) {
         Mat4 transformation = frame_transformation(
             Utils::degs_to_rads(g.alpha),
             Utils::degs_to_rads(g.beta),
@@ -73,25 +219,139 @@ void MeshList::add(const objl::Loader& loader, const geometry_params_t& g) {
             g.scale,
             g.t);
 
-        _logger->add_mesh_obj();
-        Mesh m(mesh, std::move(transformation), std::move(transformation_inv), *this);
-        _logger->add_tris(m.get_triangles().size());
-        _meshes.push_back(std::move(m));
+        _logger->add_instance();
+        _instances.emplace_back(mesh, std::move(transformation), std::move(transformation_inv));
     }
 }
 
-bool MeshList::hit(const Ray& r_in, const Interval& ray_t, HitRecord& hitrec) const {
-    HitRecord temp_rec;
-    bool hit_anything{ false };
-    float closest_so_far{ ray_t.max() };
-    for (const auto& mesh : _meshes) {
-        if (mesh.hit(r_in, Interval(ray_t.min(), closest_so_far), temp_rec) && temp_rec.get_t() < closest_so_far) {
-            hit_anything = true;
-            closest_so_far = temp_rec.get_t();
-            hitrec = temp_rec;
-            temp_rec = HitRecord();
+void MeshList::build_top_level() {
+    /**
+     * @brief: builds the top level BVH over the instances world bounding
+     * boxes, to be called once every geometry has been added
+     * @details: instances are then reordered as the BVH leaves, so that
+     * each leaf addresses a contiguous range of _instances
+     */
+    std::vector<BoundingBox> instance_bounds;
+    instance_bounds.reserve(_instances.size());
+    for (const auto& instance : _instances) {
+        instance_bounds.push_back(instance.bbox());
+    }
+
+    _top_level = BVHTree{ instance_bounds, 1 };
+
+    std::vector<Instance> ordered;
+    ordered.reserve(_instances.size());
+    for (auto idx : _top_level.prim_indices()) {
+        ordered.push_back(std::move(_instances[idx]));
+    }
+
+    _instances = std::move(ordered);
+    _grids_only = std::all_of(_instances.begin(), _instances.end(), [](const Instance& i) { return i.mesh().grid() != nullptr; });
+    _logger->set_top_level(_top_level.num_nodes(), _top_level.num_leaves(), _top_level.depth());
+}
+
+bool MeshList::hit(const Ray& r_in, const Interval& ray_t, intersection_t& isect) const {
+    /**
+     * @brief: two level traversal, the top level BVH visits the instances
+     * nearest first and culls those starting behind the closest hit so far,
+     * each instance then traverses its mesh acceleration structure in object space
+     */
+    assert(_instances.empty() || _top_level.num_nodes() > 0);
+
+    return _top_level.traverse(r_in, ray_t, [&](uint32_t first, uint32_t count, float& closest) {
+        intersection_t candidate;
+        bool hit_anything{ false };
+        for (uint32_t i = first; i < first + count; ++i) {
+            if (_instances[i].hit(r_in, Interval(ray_t.min(), closest), candidate) && candidate.t < closest) {
+                hit_anything = true;
+                closest = candidate.t;
+                isect = candidate;
+                isect.instance = i;
+            }
+        }
+
+        return hit_anything;
+    });
+}
+
+bool MeshList::occluded(const Ray& r_in, const Interval& ray_t) const {
+    /**
+     * @brief: any hit query for shadow and visibility rays, ends at the first
+     * instance hit anywhere in ray_t and never evaluates hit attributes
+     */
+    assert(_instances.empty() || _top_level.num_nodes() > 0);
+
+    return _top_level.traverse(r_in, ray_t, [&](uint32_t first, uint32_t count, float& closest) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            if (_instances[i].occluded(r_in, ray_t)) {
+                closest = -inf;
+                return true;
+            }
         }
+
+        return false;
+    });
+}
+
+void MeshList::hit(ray_packet_t& packet) const {
+    /**
+     * @brief: closest hits of a packet of rays, the top level BVH is
+     * walked once by the whole packet, then each instance is entered by
+     * the rays that overlap its bounding box
+     * @details: the t, u, v, prim and instance of every ray hold its
+     * closest hit afterwards. Packets only beat single rays when their
+     * rays share the origin and the meshes are in grids, see packet_traversal()
+     */
+    assert(_instances.empty() || _top_level.num_nodes() > 0);
+
+    _top_level.traverse(packet, [&](uint32_t first, uint32_t count, uint64_t rays) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            _instances[i].hit(packet, i, rays);
+        }
+    });
+}
+
+void MeshList::hit(const RayQueue& rays, const Interval& ray_t, std::vector<intersection_t>& isects) const {
+    /**
+     * @brief: closest hits of all the rays of a wavefront queue, isects[k]
+     * is the one of rays.ray(k) and isects must hold rays.size() entries
+     * @details: the rays are sorted by the octant of their direction and
+     * traced in packets of consecutive rays of the same octant, so that
+     * every packet walks the top level BVH once and its rays overlap the
+     * same instances. Camera rays share their origin and walk the grids
+     * with the coherent traversal, the rays of later bounces go down to
+     * the meshes one at a time. The sort is stable, queues are in pixel
+     * order so that neighbouring pixels end up in the same packet
+     */
+    thread_local std::vector<uint32_t> order;
+    uint32_t octant_start[9]{};
+    for (uint32_t k = 0; k < rays.size(); ++k) {
+        ++octant_start[rays.octant(k) + 1];
+    }
+    for (uint32_t o = 0; o < 8; ++o) {
+        octant_start[o + 1] += octant_start[o];
     }
+    order.resize(rays.size());
+    uint32_t fill[8];
+    std::copy(octant_start, octant_start + 8, fill);
+    for (uint32_t k = 0; k < rays.size(); ++k) {
+        order[fill[rays.octant(k)]++] = k;
+    }
+
+    ray_packet_t packet;
+    for (uint32_t o = 0; o < 8; ++o) {
+        for (uint32_t first = octant_start[o]; first < octant_start[o + 1]; first += ray_packet_t::max_size) {
+            uint32_t last = std::min(first + ray_packet_t::max_size, octant_start[o + 1]);
+            RayPackets::start(packet);
+            for (uint32_t i = first; i < last; ++i) {
+                RayPackets::push(packet, rays.ray(order[i]), ray_t.min(), ray_t.max());
+            }
+            RayPackets::close(packet);
+            hit(packet);
 
-    return hit_anything;
+            for (uint32_t i = first; i < last; ++i) {
+                isects[order[i]] = RayPackets::intersection(packet, i - first);
+            }
+        }
+    }
 }
\ No newline at end of file
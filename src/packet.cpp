@@ -0,0 +1,58 @@
+#include "packet.h"
+
+void RayPackets::start(ray_packet_t& packet) {
+    packet.shared_origin = true;
+    packet.size = 0;
+}
+
+void RayPackets::push(ray_packet_t& packet, const Ray& r, float t_min, float t_max) {
+    /**
+     * @brief: appends r with no hit yet
+     */
+    uint32_t k = packet.size++;
+    if (k == 0) {
+        packet.origin = r.origin();
+    } else if (r.origin().x() != packet.origin.x() || r.origin().y() != packet.origin.y() || r.origin().z() != packet.origin.z()) {
+        packet.shared_origin = false;
+    }
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        packet.o[i][k] = r.origin()[i];
+        packet.dir[i][k] = r.direction()[i];
+        packet.inv_dir[i][k] = r.inv_dir()[i];
+    }
+    packet.t_min[k] = t_min;
+    packet.t[k] = t_max;
+    packet.prim[k] = UINT32_MAX;
+    packet.instance[k] = UINT32_MAX;
+}
+
+void RayPackets::close(ray_packet_t& packet) {
+    /**
+     * @brief: pads the last chunk of lanes, to be called once every ray is pushed
+     * @details: an empty interval keeps the padding lanes from ever hitting
+     */
+    uint32_t end = (packet.size + Simd::width - 1) / Simd::width * Simd::width;
+    for (uint32_t k = packet.size; k < end; ++k) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            packet.o[i][k] = 0.f;
+            packet.dir[i][k] = 0.f;
+            packet.inv_dir[i][k] = 0.f;
+        }
+        packet.t_min[k] = 0.f;
+        packet.t[k] = 0.f;
+        packet.prim[k] = UINT32_MAX;
+        packet.instance[k] = UINT32_MAX;
+    }
+}
+
+intersection_t RayPackets::intersection(const ray_packet_t& packet, uint32_t k) {
+    intersection_t isect;
+    isect.t = packet.t[k];
+    isect.u = packet.u[k];
+    isect.v = packet.v[k];
+    isect.prim = packet.prim[k];
+    isect.instance = packet.instance[k];
+
+    return isect;
+}
\ No newline at end of file
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+#include "pngwriter.h"
+
+static const std::array<uint32_t, 256>& crc_table() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (uint32_t k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+
+        return t;
+    }();
+
+    return table;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t x) {
+    out.push_back(static_cast<uint8_t>(x >> 24));
+    out.push_back(static_cast<uint8_t>(x >> 16));
+    out.push_back(static_cast<uint8_t>(x >> 8));
+    out.push_back(static_cast<uint8_t>(x));
+}
+
+Deflater::Deflater()
+: _head(1u << _hash_bits, -1), _prev(_window, -1)
+{
+    _out = { 0x78, 0x5e }; // zlib header, 32K window, no dictionary
+}
+
+void Deflater::_put_bits(uint32_t value, uint32_t count) {
+    _bits |= static_cast<uint64_t>(value) << _num_bits;
+    _num_bits += count;
+    while (_num_bits >= 8) {
+        _out.push_back(static_cast<uint8_t>(_bits));
+        _bits >>= 8;
+        _num_bits -= 8;
+    }
+}
+
+void Deflater::_put_huffman(uint32_t code, uint32_t length) {
+    // Huffman codes are packed starting from their most significant bit
+    uint32_t reversed{ 0 };
+    for (uint32_t k = 0; k < length; ++k) {
+        reversed |= ((code >> k) & 1) << (length - 1 - k);
+    }
+    _put_bits(reversed, length);
+}
+
+void Deflater::_put_literal(uint32_t symbol) {
+    // fixed literal/length code, RFC 1951 3.2.6
+    if (symbol <= 143) {
+        _put_huffman(0x30 + symbol, 8);
+    } else if (symbol <= 255) {
+        _put_huffman(0x190 + symbol - 144, 9);
+    } else if (symbol <= 279) {
+        _put_huffman(symbol - 256, 7);
+    } else {
+        _put_huffman(0xc0 + symbol - 280, 8);
+    }
+}
+
+void Deflater::_put_match(uint32_t length, uint32_t dist) {
+    static constexpr uint16_t len_base[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr uint8_t len_extra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr uint16_t dist_base[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static constexpr uint8_t dist_extra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    uint32_t l = std::upper_bound(std::begin(len_base), std::end(len_base), length) - std::begin(len_base) - 1;
+    _put_literal(257 + l);
+    _put_bits(length - len_base[l], len_extra[l]);
+
+    uint32_t d = std::upper_bound(std::begin(dist_base), std::end(dist_base), dist) - std::begin(dist_base) - 1;
+    _put_huffman(d, 5);
+    _put_bits(dist - dist_base[d], dist_extra[d]);
+}
+
+uint32_t Deflater::_hash(size_t pos) const {
+    const uint8_t* p = &_data[pos - _base];
+    uint32_t x = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+
+    return (x * 2654435761u) >> (32 - _hash_bits);
+}
+
+void Deflater::_insert(size_t pos) {
+    uint32_t h = _hash(pos);
+    _prev[pos % _window] = _head[h];
+    _head[h] = static_cast<int64_t>(pos);
+}
+
+std::vector<uint8_t> Deflater::compress(const uint8_t* data, size_t size) {
+    /**
+     * @brief: compresses the next piece of the stream in its own block,
+     * returns the bytes of the stream completed so far
+     */
+    if (_data.size() > _window) {
+        size_t drop = _data.size() - _window;
+        _data.erase(_data.begin(), _data.begin() + drop);
+        _base += drop;
+    }
+    size_t pos = _base + _data.size();
+    _data.insert(_data.end(), data, data + size);
+    const size_t end = _base + _data.size();
+
+    // adler-32 of the uncompressed data, reduced before the sums can overflow
+    for (size_t k = 0; k < size;) {
+        size_t n = std::min<size_t>(5552, size - k);
+        for (size_t q = 0; q < n; ++q) {
+            _adler_a += data[k + q];
+            _adler_b += _adler_a;
+        }
+        _adler_a %= 65521;
+        _adler_b %= 65521;
+        k += n;
+    }
+
+    _put_bits(0, 1); // not the last block
+    _put_bits(1, 2); // fixed Huffman codes
+    while (pos < end) {
+        uint32_t best_len{ 0 };
+        uint32_t best_dist{ 0 };
+        if (pos + _min_match <= end) {
+            const uint32_t max_len = static_cast<uint32_t>(std::min<size_t>(_max_match, end - pos));
+            const uint8_t* cur = &_data[pos - _base];
+            int64_t cand = _head[_hash(pos)];
+            for (uint32_t c = 0; c < _max_chain && cand >= 0; ++c) {
+                size_t dist = pos - static_cast<size_t>(cand);
+                if (dist > _window) {
+                    break;
+                }
+
+                const uint8_t* prev = &_data[static_cast<size_t>(cand) - _base];
+                uint32_t len{ 0 };
+                while (len < max_len && prev[len] == cur[len]) {
+                    ++len;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = static_cast<uint32_t>(dist);
+                    if (len == max_len) {
+                        break;
+                    }
+                }
+                cand = _prev[static_cast<size_t>(cand) % _window];
+            }
+            _insert(pos);
+        }
+
+        if (best_len >= _min_match) {
+            _put_match(best_len, best_dist);
+            for (uint32_t k = 1; k < best_len; ++k) {
+                if (pos + k + _min_match <= end) {
+                    _insert(pos + k);
+                }
+            }
+            pos += best_len;
+        } else {
+            _put_literal(_data[pos - _base]);
+            ++pos;
+        }
+    }
+    _put_literal(256); // end of block
+
+    return std::exchange(_out, {});
+}
+
+std::vector<uint8_t> Deflater::finish() {
+    /**
+     * @brief: closes the stream with an empty last block and the
+     * adler-32 checksum, returns the remaining bytes
+     */
+    _put_bits(1, 1);
+    _put_bits(1, 2);
+    _put_literal(256);
+    if (_num_bits > 0) {
+        _put_bits(0, 8 - _num_bits);
+    }
+    put_be32(_out, (_adler_b << 16) | _adler_a);
+
+    return std::exchange(_out, {});
+}
+
+PngWriter::PngWriter(const Framebuffer& framebuffer, const std::string& path)
+: _framebuffer(framebuffer), _path(path), _row_pixels(framebuffer.height(), 0)
+{
+    _thread = std::thread{ &PngWriter::_run, this };
+}
+
+PngWriter::~PngWriter() {
+    if (_thread.joinable()) {
+        abort();
+    }
+}
+
+void PngWriter::tile_final(const tile_t& tile) {
+    /**
+     * @brief: marks the pixels of tile as final, the rows completed in
+     * order are handed to the writer thread
+     */
+    std::lock_guard<std::mutex> lk(_mut);
+    for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+        _row_pixels[j] += tile.width();
+    }
+
+    uint32_t ready = _ready_rows;
+    while (ready < _framebuffer.height() && _row_pixels[ready] == _framebuffer.width()) {
+        ++ready;
+    }
+    if (ready != _ready_rows) {
+        _ready_rows = ready;
+        _cv.notify_one();
+    }
+}
+
+bool PngWriter::finish() {
+    /**
+     * @brief: the whole framebuffer is final, waits for the file to be
+     * complete and returns whether it was written
+     */
+    {
+        std::lock_guard<std::mutex> lk(_mut);
+        _ready_rows = _framebuffer.height();
+    }
+    _cv.notify_one();
+    _thread.join();
+
+    return _ok;
+}
+
+void PngWriter::abort() {
+    /**
+     * @brief: stops the writer and removes the incomplete file
+     */
+    {
+        std::lock_guard<std::mutex> lk(_mut);
+        _aborted = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+
+    if (!_ok) {
+        std::error_code err;
+        std::filesystem::remove(_path, err);
+    }
+}
+
+void PngWriter::_write_chunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) const {
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    put_be32(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    uint32_t crc{ 0xffffffffu };
+    for (size_t k = 4; k < chunk.size(); ++k) {
+        crc = crc_table()[(crc ^ chunk[k]) & 0xff] ^ (crc >> 8);
+    }
+    put_be32(chunk, crc ^ 0xffffffffu);
+
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+void PngWriter::_filter_row(uint32_t j, std::vector<uint8_t>& out) const {
+    /**
+     * @brief: appends row j with the PNG filter that leaves the smallest
+     * residuals, the heuristic of stb_image_write
+     */
+    const size_t n = static_cast<size_t>(_framebuffer.width()) * 4;
+    const uint8_t* cur = reinterpret_cast<const uint8_t*>(_framebuffer.row(j));
+    const uint8_t* up = j > 0 ? reinterpret_cast<const uint8_t*>(_framebuffer.row(j - 1)) : nullptr;
+
+    auto paeth = [](int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) {
+            return a;
+        }
+
+        return pb <= pc ? b : c;
+    };
+
+    std::vector<uint8_t> trial(n);
+    std::vector<uint8_t> best(n);
+    int64_t best_score{ -1 };
+    uint8_t best_filter{ 0 };
+    for (uint8_t filter = 0; filter < 5; ++filter) {
+        int64_t score{ 0 };
+        for (size_t k = 0; k < n; ++k) {
+            int a = k >= 4 ? cur[k - 4] : 0;
+            int b = up ? up[k] : 0;
+            int c = (up && k >= 4) ? up[k - 4] : 0;
+            int pred{ 0 };
+            switch (filter) {
+                case 1:
+                    pred = a;
+                    break;
+                case 2:
+                    pred = b;
+                    break;
+                case 3:
+                    pred = (a + b) >> 1;
+                    break;
+                case 4:
+                    pred = paeth(a, b, c);
+                    break;
+                default:
+                    break;
+            }
+            trial[k] = static_cast<uint8_t>(cur[k] - pred);
+            score += std::abs(static_cast<int8_t>(trial[k]));
+        }
+
+        if (best_score < 0 || score < best_score) {
+            best_score = score;
+            best_filter = filter;
+            std::swap(best, trial);
+        }
+    }
+
+    out.push_back(best_filter);
+    out.insert(out.end(), best.begin(), best.end());
+}
+
+void PngWriter::_run() {
+    /**
+     * @brief: writer thread, the rows that became final since the last
+     * wake up are compressed in one piece and written as an IDAT chunk
+     * @details: the framebuffer stores R, G, B, A bytes, the layout of
+     * 8 bit RGBA .png rows
+     */
+    std::ofstream file(_path, std::ios::binary);
+    if (!file) {
+        std::cerr << "\nFailed to save .png file\n";
+        return;
+    }
+
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    put_be32(header, _framebuffer.width());
+    put_be32(header, _framebuffer.height());
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit depth, RGBA, deflate, adaptive filters, no interlace
+    _write_chunk(file, "IHDR", header);
+
+    Deflater deflater;
+    std::vector<uint8_t> rows;
+    uint32_t j{ 0 };
+    while (j < _framebuffer.height()) {
+        uint32_t ready;
+        {
+            std::unique_lock<std::mutex> lk(_mut);
+            _cv.wait(lk, [&] { return _aborted || _ready_rows > j; });
+            if (_aborted) {
+                return;
+            }
+            ready = _ready_rows;
+        }
+
+        rows.clear();
+        for (; j < ready; ++j) {
+            _filter_row(j, rows);
+        }
+        _write_chunk(file, "IDAT", deflater.compress(rows.data(), rows.size()));
+    }
+
+    _write_chunk(file, "IDAT", deflater.finish());
+    _write_chunk(file, "IEND", {});
+    file.close();
+    _ok = !file.fail();
+    if (!_ok) {
+        std::cerr << "\nFailed to save .png file\n";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sampler.h"
+#include "interval.h"
+
+static std::vector<float> void_and_cluster(uint32_t size, float sigma) {
+    /**
+     * @brief: Ulichney's void and cluster method on a size x size torus
+     * @details: the energy of a pixel is the gaussian weighted count of the
+     * ones around it. An initial random pattern is relaxed by moving its
+     * tightest cluster to its largest void until nothing moves, then ones are
+     * removed from the tightest clusters to rank the initial pattern and added
+     * to the largest voids to rank the rest. Past half full the tightest
+     * cluster of zeros is the largest void of ones, so the last two phases
+     * of the original method are the same loop. Returns the ranks as
+     * thresholds in (0, 1)
+     */
+    const uint32_t n = size * size;
+    std::vector<float> kernel(n);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            float dx = std::min(x, size - x);
+            float dy = std::min(y, size - y);
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+        }
+    }
+
+    std::vector<uint8_t> ones(n, 0);
+    std::vector<float> energy(n, 0.f);
+    auto update = [&](uint32_t p, float sign) {
+        uint32_t px = p % size;
+        uint32_t py = p / size;
+        for (uint32_t y = 0; y < size; ++y) {
+            const float* k_row = &kernel[((y + size - py) % size) * size];
+            float* e_row = &energy[y * size];
+            for (uint32_t x = 0; x < size; ++x) {
+                e_row[x] += sign * k_row[(x + size - px) % size];
+            }
+        }
+    };
+
+    auto set = [&](uint32_t p, uint8_t value) {
+        ones[p] = value;
+        update(p, value ? 1.f : -1.f);
+    };
+
+    auto tightest_cluster = [&]() {
+        uint32_t best{ 0 };
+        float best_e{ -inf };
+        for (uint32_t p = 0; p < n; ++p) {
+            if (ones[p] && energy[p] > best_e) {
+                best_e = energy[p];
+                best = p;
+            }
+        }
+
+        return best;
+    };
+
+    auto largest_void = [&]() {
+        uint32_t best{ 0 };
+        float best_e{ inf };
+        for (uint32_t p = 0; p < n; ++p) {
+            if (!ones[p] && energy[p] < best_e) {
+                best_e = energy[p];
+                best = p;
+            }
+        }
+
+        return best;
+    };
+
+    // fixed seed, the mask is the same on every run
+    RandomUtils::Pcg32 rng{ 0x6a09e667f3bcc908ull, 0 };
+    uint32_t n_initial = n / 10;
+    for (uint32_t placed = 0; placed < n_initial;) {
+        uint32_t p = rng.next_uint() % n;
+        if (!ones[p]) {
+            set(p, 1);
+            ++placed;
+        }
+    }
+
+    for (uint32_t iter = 0; iter < n; ++iter) {
+        uint32_t cluster = tightest_cluster();
+        set(cluster, 0);
+        uint32_t hole = largest_void();
+        set(hole, 1);
+        if (hole == cluster) {
+            break;
+        }
+    }
+
+    std::vector<uint32_t> rank(n);
+    std::vector<uint8_t> initial = ones;
+    std::vector<float> initial_energy = energy;
+    for (uint32_t r = n_initial; r > 0; --r) {
+        uint32_t p = tightest_cluster();
+        set(p, 0);
+        rank[p] = r - 1;
+    }
+
+    ones = std::move(initial);
+    energy = std::move(initial_energy);
+    for (uint32_t r = n_initial; r < n; ++r) {
+        uint32_t p = largest_void();
+        set(p, 1);
+        rank[p] = r;
+    }
+
+    std::vector<float> thresholds(n);
+    for (uint32_t p = 0; p < n; ++p) {
+        thresholds[p] = (rank[p] + 0.5f) / n;
+    }
+
+    return thresholds;
+}
+
+AliasTable::AliasTable(const std::vector<float>& weights)
+: _prob(weights.size(), 1.f), _alias(weights.size()), _pdf(weights.size(), 0.f)
+{
+    /**
+     * @details: bins below the mean weight are topped up by a bin above
+     * it, which then goes back to the small or large list with what is
+     * left. Bins left over by rounding keep probability 1. Negative and
+     * NaN weights count as 0, all zero weights give a uniform table
+     */
+    const uint32_t n = weights.size();
+    double total{ 0 };
+    for (float w : weights) {
+        total += w > 0.f ? w : 0.f;
+    }
+
+    std::vector<double> scaled(n);
+    for (uint32_t k = 0; k < n; ++k) {
+        float w = weights[k] > 0.f ? weights[k] : 0.f;
+        _pdf[k] = total > 0 ? static_cast<float>(w / total) : 1.f / n;
+        scaled[k] = static_cast<double>(_pdf[k]) * n;
+        _alias[k] = k;
+    }
+
+    std::vector<uint32_t> small, large;
+    for (uint32_t k = 0; k < n; ++k) {
+        (scaled[k] < 1.0 ? small : large).push_back(k);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back();
+        uint32_t l = large.back();
+        small.pop_back();
+        large.pop_back();
+
+        _prob[s] = static_cast<float>(scaled[s]);
+        _alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+}
+
+const std::vector<float>& BlueNoise::mask() {
+    /**
+     * @brief: mask_size x mask_size blue noise dither mask, row major,
+     * every value (k + 0.5) / mask_size^2 appears exactly once
+     * @details: built on first use, a few tens of milliseconds
+     */
+    static const std::vector<float> m = void_and_cluster(mask_size, 1.9f);
+
+    return m;
+}
+
+float BlueNoiseSampler::_shift(uint32_t d) const {
+    // R2 sequence offsets scatter the mask lookups of different dimensions
+    uint32_t ox = static_cast<uint32_t>(d * 0.7548776662f * BlueNoise::mask_size);
+    uint32_t oy = static_cast<uint32_t>(d * 0.5698402910f * BlueNoise::mask_size);
+    uint32_t x = (_i + ox) % BlueNoise::mask_size;
+    uint32_t y = (_j + oy) % BlueNoise::mask_size;
+
+    return _mask[y * BlueNoise::mask_size + x];
+}
+
+sample_2d_t BlueNoiseSampler::get_2d() {
+    uint32_t d = _dim++;
+    sample_2d_t s = Sobol::owen_2d(_sample, RandomUtils::splitmix64(d));
+    float sx = s.x + _shift(2 * d);
+    float sy = s.y + _shift(2 * d + 1);
+    s.x = sx - std::floor(sx);
+    s.y = sy - std::floor(sy);
+
+    // the shifted samples can round up to 1
+    s.x = std::min(s.x, 0x1.fffffep-1f);
+    s.y = std::min(s.y, 0x1.fffffep-1f);
+
+    return s;
+}
+
+Sampler::Sampler(SamplerType type) {
+    switch (type) {
+        case SamplerType::independent:
+            _sampler = IndependentSampler{};
+            break;
+        case SamplerType::sobol:
+            _sampler = SobolSampler{};
+            break;
+        case SamplerType::blue_noise:
+            _sampler = BlueNoiseSampler{};
+            break;
+    }
+}
\ No newline at end of file
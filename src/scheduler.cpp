@@ -0,0 +1,88 @@
+#include <thread>
+#include <algorithm>
+
+#include "scheduler.h"
+
+RenderScheduler::RenderScheduler(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t num_threads)
+: _num_threads(num_threads != 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency())),
+  _queues(_num_threads)
+{
+    _split_tiles(width, height, std::max(1u, tile_size));
+}
+
+void RenderScheduler::_split_tiles(uint32_t width, uint32_t height, uint32_t tile_size) {
+    /**
+     * @brief: splits the image in square tiles in row major order,
+     * tiles on the right and bottom borders are clipped to the image
+     */
+    for (uint32_t y = 0; y < height; y += tile_size) {
+        for (uint32_t x = 0; x < width; x += tile_size) {
+            _tiles.push_back(tile_t{ x, y, std::min(x + tile_size, width), std::min(y + tile_size, height) });
+        }
+    }
+}
+
+void RenderScheduler::_seed_queues() {
+    /**
+     * @brief: gives each worker a contiguous run of tiles so that
+     * neighbouring tiles (and the geometry they see) stay on the
+     * same core, load imbalance is then fixed by stealing
+     */
+    uint32_t n_tiles = _tiles.size();
+    for (uint32_t t = 0; t < _num_threads; ++t) {
+        while (_queues[t].try_pop()) {} // leftovers of a cancelled run
+
+        uint32_t begin = static_cast<uint64_t>(n_tiles) * t / _num_threads;
+        uint32_t end = static_cast<uint64_t>(n_tiles) * (t + 1) / _num_threads;
+        for (uint32_t i = begin; i < end; ++i) {
+            _queues[t].push(tile_t{ _tiles[i] });
+        }
+    }
+}
+
+std::optional<tile_t> RenderScheduler::_steal(uint32_t thief) {
+    for (uint32_t i = 1; i < _num_threads; ++i) {
+        std::optional<tile_t> tile = _queues[(thief + i) % _num_threads].try_steal();
+        if (tile) {
+            return tile;
+        }
+    }
+
+    return std::optional<tile_t>();
+}
+
+void RenderScheduler::_worker(uint32_t id, const std::function<void(const tile_t&)>& job, const std::atomic<bool>& cancel) {
+    /**
+     * @details: no tile is ever pushed once the workers are running,
+     * so a worker that finds every deque empty can safely retire
+     */
+    while (!cancel) {
+        std::optional<tile_t> tile = _queues[id].try_pop();
+        if (!tile) {
+            tile = _steal(id);
+        }
+        if (!tile) {
+            break;
+        }
+
+        job(tile.value());
+    }
+}
+
+void RenderScheduler::run(const std::function<void(const tile_t&)>& job, const std::atomic<bool>& cancel) {
+    /**
+     * @brief: renders every tile once with a pool of _num_threads
+     * workers and returns when all of them are done (or cancel is set)
+     */
+    _seed_queues();
+
+    std::vector<std::thread> workers;
+    workers.reserve(_num_threads);
+    for (uint32_t t = 0; t < _num_threads; ++t) {
+        workers.emplace_back(&RenderScheduler::_worker, this, t, std::cref(job), std::cref(cancel));
+    }
+
+    for (auto& w : workers) {
+        w.join();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+
+#include "tonemap.h"
+
+namespace {
+struct Identity {
+    Simd::floatv operator()(Simd::floatv x) const { return x; }
+    float operator()(float x) const { return x; }
+};
+
+struct Reinhard {
+    Simd::floatv operator()(Simd::floatv x) const { return x / (Simd::set1(1.f) + x); }
+    float operator()(float x) const { return x / (1.f + x); }
+};
+
+struct Aces {
+    /**
+     * @brief: Narkowicz's rational fit of the ACES reference rendering
+     * and output transforms, applied per channel
+     */
+    static constexpr float a = 2.51f;
+    static constexpr float b = 0.03f;
+    static constexpr float c = 2.43f;
+    static constexpr float d = 0.59f;
+    static constexpr float e = 0.14f;
+
+    Simd::floatv operator()(Simd::floatv x) const {
+        Simd::floatv num = x * (Simd::set1(a) * x + Simd::set1(b));
+        Simd::floatv den = x * (Simd::set1(c) * x + Simd::set1(d)) + Simd::set1(e);
+
+        return num / den;
+    }
+
+    float operator()(float x) const { return (x * (a * x + b)) / (x * (c * x + d) + e); }
+};
+} // namespace
+
+Tonemapper::Tonemapper(SDL_PixelFormat format, TonemapType tonemap, bool gamma_corr)
+: _tonemap(tonemap), _gamma_corr(gamma_corr)
+{
+    const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails(format);
+    _r_shift = details->Rshift;
+    _g_shift = details->Gshift;
+    _b_shift = details->Bshift;
+    _alpha = details->Amask;
+}
+
+template<typename Curve>
+void Tonemapper::_pack(const float* r, const float* g, const float* b, uint32_t n, uint32_t* out, Curve curve) const {
+    const Simd::floatv zero = Simd::set1(0.f);
+    const Simd::floatv max_intensity = Simd::set1(0.999f);
+    const Simd::floatv scale = Simd::set1(255.f);
+    const Simd::intv alpha = Simd::set1_int(_alpha);
+
+    auto to_byte = [&](const float* channel, uint32_t k) {
+        // NaNs and negative radiance go to 0 before the curve
+        Simd::floatv x = curve(Simd::max(Simd::load(channel + k), zero));
+        if (_gamma_corr) {
+            x = Simd::sqrt(x);
+        }
+
+        return Simd::to_int(Simd::min(x, max_intensity) * scale);
+    };
+
+    auto pixels = [&](uint32_t k) {
+        return Simd::shift_left(to_byte(r, k), _r_shift) |
+               Simd::shift_left(to_byte(g, k), _g_shift) |
+               Simd::shift_left(to_byte(b, k), _b_shift) |
+               alpha;
+    };
+
+    uint32_t k{ 0 };
+    for (; k + Simd::width <= n; k += Simd::width) {
+        Simd::storeu(out + k, pixels(k));
+    }
+
+    if (k < n) {
+        uint32_t tail[Simd::width];
+        Simd::storeu(tail, pixels(k));
+        std::copy(tail, tail + (n - k), out + k);
+    }
+}
+
+void Tonemapper::pack(const float* r, const float* g, const float* b, uint32_t n, uint32_t* out) const {
+    /**
+     * @brief: packs n pixels given as separate r, g, b spans of linear
+     * radiance into out, in the pixel format of the tonemapper
+     * @details: the spans must be aligned to span_alignment and readable up
+     * to n rounded up to a multiple of Simd::width, only n pixels are written
+     */
+    switch (_tonemap) {
+        case TonemapType::reinhard:
+            _pack(r, g, b, n, out, Reinhard{});
+            break;
+        case TonemapType::aces:
+            _pack(r, g, b, n, out, Aces{});
+            break;
+        default:
+            _pack(r, g, b, n, out, Identity{});
+            break;
+    }
+}
+
+uint32_t Tonemapper::pack(const Color& color) const {
+    /**
+     * @brief: scalar version of the simd pass, for a single pixel
+     */
+    auto to_byte = [&](float x) {
+        x = x > 0.f ? x : 0.f;
+        switch (_tonemap) {
+            case TonemapType::reinhard:
+                x = Reinhard{}(x);
+                break;
+            case TonemapType::aces:
+                x = Aces{}(x);
+                break;
+            default:
+                break;
+        }
+        if (_gamma_corr) {
+            x = std::sqrt(x);
+        }
+
+        // NaN, e.g. inf / inf from the curve, clamps to the top like in the simd min
+        return static_cast<uint32_t>((x < 0.999f ? x : 0.999f) * 255.f);
+    };
+
+    return (to_byte(color.x()) << _r_shift) |
+           (to_byte(color.y()) << _g_shift) |
+           (to_byte(color.z()) << _b_shift) |
+           _alpha;
+}
\ No newline at end of file
@@ -23,21 +23,19 @@ Triangle::Triangle(const vertex_t& v0, const vertex_t& v1, const vertex_t& v2, c
     _set_bbox();
 }
 
-bool Triangle::hit(const Ray &r_in, const Interval &ray_t, HitRecord &hitrec) const {
+bool Triangle::hit(const Ray &r_in, const Interval &ray_t, intersection_t &isect) const {
     /**
      * @brief: ray-triangle intersection method using moller-trumbore algorithm
+     * @details: scalar reference of TriBlocks::hit, the acceleration
+     * structures test whole blocks of triangles instead
      */
-    if (!_bbox.hit(r_in, ray_t, hitrec)) {
-        return false;
-    }
-
     const float tol = 1e-8;
 
     Vec3f p_vec = cross(r_in.direction(), _v0v2);
     float det = dot(_v0v1, p_vec);
 
-    // use std::fabs(det) to disable backface culling
-    if (det < tol) {
+    // two sided, bounced rays leave closed meshes from the inside of their faces
+    if (std::fabs(det) < tol) {
         return false;
     }
 
@@ -55,13 +53,13 @@ bool Triangle::hit(const Ray &r_in, const Interval &ray_t, HitRecord &hitrec) co
     }
     
     float t = dot(_v0v2, q_vec) * det_inv;
-    hitrec.set_u(u);
-    hitrec.set_v(v);
-    hitrec.set_t(t);
-    hitrec.set_hit_point(r_in.at(t));
-    hitrec.set_normal((1.f - u - v) * _v0.normal + u * _v1.normal + v * _v2.normal);
-    hitrec.set_color(_color * std::fmax(0.f, -dot(hitrec.get_normal(), r_in.direction())));
-    //hitrec.set_color(_color);
+    if (!ray_t.surrounds(t)) {
+        return false;
+    }
+
+    isect.t = t;
+    isect.u = u;
+    isect.v = v;
 
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "triblock.h"
+
+void TriBlocks::set_lane(tri_block_t& block, uint32_t lane, const Triangle& tri, uint32_t tri_idx) {
+    for (uint32_t i = 0; i < 3; ++i) {
+        block.v0[i][lane] = tri.v0().pos[i];
+        block.e1[i][lane] = tri.v0v1()[i];
+        block.e2[i][lane] = tri.v0v2()[i];
+    }
+    block.idx[lane] = tri_idx;
+}
+
+void TriBlocks::clear_lanes(tri_block_t& block, uint32_t first_lane) {
+    /**
+     * @details: zero edges give a zero determinant, so padding lanes
+     * never pass the intersection test
+     */
+    for (uint32_t lane = first_lane; lane < Simd::width; ++lane) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            block.v0[i][lane] = 0.f;
+            block.e1[i][lane] = 0.f;
+            block.e2[i][lane] = 0.f;
+        }
+        block.idx[lane] = UINT32_MAX;
+    }
+}
+
+void TriBlocks::append(std::vector<tri_block_t>& blocks, const std::vector<Triangle>& tris, const uint32_t* indices, uint32_t count) {
+    /**
+     * @brief: packs the count triangles tris[indices[i]] into
+     * ceil(count / Simd::width) blocks, the last one padded
+     */
+    for (uint32_t i = 0; i < count; i += Simd::width) {
+        tri_block_t& block = blocks.emplace_back();
+        uint32_t lanes = std::min(Simd::width, count - i);
+        for (uint32_t lane = 0; lane < lanes; ++lane) {
+            set_lane(block, lane, tris[indices[i + lane]], indices[i + lane]);
+        }
+        clear_lanes(block, lanes);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,581 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <vector>
+#include <thread>
+#include <numbers>
+#include <memory>
+#include <numeric>
+#include <bit>
+
+#include "grid.h"
+#include "bvh.h"
+#include "triblock.h"
+#include "packet.h"
+#include "mesh.h"
+#include "utils.h"
+
+static std::vector<Triangle> uv_sphere(uint32_t n_theta, uint32_t n_phi, float radius) {
+    /**
+     * @brief: tessellated sphere with outward facing triangles
+     */
+    auto vertex = [&](uint32_t it, uint32_t ip) {
+        float theta = std::numbers::pi * it / n_theta;
+        float phi = 2.f * std::numbers::pi * ip / n_phi;
+        Vec3f n{ std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi) };
+        return vertex_t{ radius * n, n };
+    };
+
+    std::vector<Triangle> tris;
+    for (uint32_t it = 0; it < n_theta; ++it) {
+        for (uint32_t ip = 0; ip < n_phi; ++ip) {
+            vertex_t a = vertex(it, ip);
+            vertex_t b = vertex(it + 1, ip);
+            vertex_t c = vertex(it + 1, ip + 1);
+            vertex_t d = vertex(it, ip + 1);
+            tris.emplace_back(a, b, c, Color(1.f));
+            tris.emplace_back(a, c, d, Color(1.f));
+        }
+    }
+
+    return tris;
+}
+
+static objl::Mesh to_objl_mesh(const std::vector<Triangle>& tris, const Vec3f& offset) {
+    /**
+     * @brief: loader mesh with three unique vertices per triangle, as OBJ-Loader emits them
+     */
+    objl::Mesh mesh;
+    for (const auto& tri : tris) {
+        for (const auto& v : { tri.v0(), tri.v1(), tri.v2() }) {
+            Vec3f p = v.pos + offset;
+            objl::Vertex vertex;
+            vertex.Position = objl::Vector3(p.x(), p.y(), p.z());
+            vertex.Normal = objl::Vector3(v.normal.x(), v.normal.y(), v.normal.z());
+            mesh.Indices.push_back(mesh.Vertices.size());
+            mesh.Vertices.push_back(vertex);
+        }
+    }
+
+    return mesh;
+}
+
+static BoundingBox tris_bbox(const std::vector<Triangle>& tris) {
+    Vec3f pmin{ inf };
+    Vec3f pmax{ -inf };
+    for (const auto& tri : tris) {
+        Utils::set_pmin_pmax(pmin, pmax, tri.v0().pos);
+        Utils::set_pmin_pmax(pmin, pmax, tri.v1().pos);
+        Utils::set_pmin_pmax(pmin, pmax, tri.v2().pos);
+    }
+
+    return BoundingBox{ pmin, pmax };
+}
+
+static std::vector<Ray> camera_rays(uint32_t n) {
+    std::vector<Ray> rays;
+    Vec3f origin{ 0.3f, 0.2f, 3.f };
+    for (uint32_t j = 0; j < n; ++j) {
+        for (uint32_t i = 0; i < n; ++i) {
+            Vec3f target{ -1.5f + 3.f * i / n, -1.5f + 3.f * j / n, 0.f };
+            rays.emplace_back(origin, target - origin);
+        }
+    }
+
+    return rays;
+}
+
+static intersection_t brute_force_hit(const std::vector<Triangle>& tris, const Ray& r, const Interval& ray_t) {
+    intersection_t closest;
+    closest.t = ray_t.max();
+    for (uint32_t i = 0; i < tris.size(); ++i) {
+        if (tris[i].hit(r, Interval(ray_t.min(), closest.t), closest)) {
+            closest.prim = i;
+        }
+    }
+
+    return closest;
+}
+
+TEST_CASE("Triangle blocks") {
+
+std::vector<Triangle> tris = uv_sphere(12, 24, 1.f);
+std::vector<uint32_t> indices(tris.size());
+std::iota(indices.begin(), indices.end(), 0);
+std::vector<tri_block_t> blocks;
+TriBlocks::append(blocks, tris, indices.data(), indices.size());
+std::vector<Ray> rays = camera_rays(64);
+Interval ray_t{ 0.001f, inf };
+
+SECTION("blocks are padded") {
+    REQUIRE(blocks.size() == (tris.size() + Simd::width - 1) / Simd::width);
+    for (uint32_t i = 0; i < blocks.size() * Simd::width; ++i) {
+        REQUIRE(blocks[i / Simd::width].idx[i % Simd::width] == (i < tris.size() ? i : UINT32_MAX));
+    }
+}
+
+SECTION("closest hit matches the scalar test") {
+    for (const auto& r : rays) {
+        simd_ray_t ray{ TriBlocks::broadcast(r) };
+        intersection_t closest;
+        closest.t = ray_t.max();
+        for (const auto& block : blocks) {
+            TriBlocks::hit(block, ray, ray_t.min(), TriBlocks::all_lanes, closest);
+        }
+
+        intersection_t expected = brute_force_hit(tris, r, ray_t);
+        REQUIRE(closest.prim == expected.prim);
+        if (expected.prim != UINT32_MAX) {
+            REQUIRE_THAT(closest.t, Catch::Matchers::WithinRel(expected.t, 1e-4f));
+            REQUIRE_THAT(closest.u, Catch::Matchers::WithinAbs(expected.u, 1e-4f));
+            REQUIRE_THAT(closest.v, Catch::Matchers::WithinAbs(expected.v, 1e-4f));
+        }
+    }
+}
+
+SECTION("inactive lanes are skipped") {
+    uint32_t even_lanes{ 0 };
+    for (uint32_t lane = 0; lane < Simd::width; lane += 2) {
+        even_lanes |= 1u << lane;
+    }
+
+    for (const auto& r : rays) {
+        simd_ray_t ray{ TriBlocks::broadcast(r) };
+        for (const auto& block : blocks) {
+            intersection_t closest;
+            uint32_t hits = TriBlocks::hit(block, ray, ray_t.min(), even_lanes, closest);
+            REQUIRE((hits & ~even_lanes) == 0);
+        }
+    }
+}
+}
+
+TEST_CASE("Grid traversal") {
+
+auto logger = std::make_shared<Logger>("", "accel_test.png");
+std::vector<Triangle> tris = uv_sphere(12, 24, 1.f);
+Grid grid{ tris_bbox(tris), tris, logger };
+std::vector<Ray> rays = camera_rays(64);
+Interval ray_t{ 0.001f, inf };
+
+SECTION("closest hit matches brute force") {
+    for (const auto& r : rays) {
+        intersection_t isect;
+        intersection_t expected = brute_force_hit(tris, r, ray_t);
+        bool hit = grid.hit(r, ray_t, isect);
+        REQUIRE(hit == (expected.prim != UINT32_MAX));
+        if (hit) {
+            REQUIRE_THAT(isect.t, Catch::Matchers::WithinRel(expected.t, 1e-4f));
+        }
+    }
+}
+
+SECTION("concurrent traversals of the same grid") {
+    std::vector<float> serial(rays.size(), inf);
+    for (uint32_t i = 0; i < rays.size(); ++i) {
+        intersection_t isect;
+        if (grid.hit(rays[i], ray_t, isect)) {
+            serial[i] = isect.t;
+        }
+    }
+
+    const uint32_t n_threads = 8;
+    std::vector<std::vector<float>> parallel(n_threads, std::vector<float>(rays.size(), inf));
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint32_t i = 0; i < rays.size(); ++i) {
+                intersection_t isect;
+                if (grid.hit(rays[i], ray_t, isect)) {
+                    parallel[t][i] = isect.t;
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (const auto& p : parallel) {
+        REQUIRE(p == serial);
+    }
+}
+
+SECTION("mailboxing tests every triangle at most once per ray") {
+    for (const auto& r : rays) {
+        intersection_t isect;
+        grid.hit(r, ray_t, isect);
+    }
+
+    auto counters = logger->counters();
+    REQUIRE(counters.avoided_ray_tri_intersections > 0);
+    REQUIRE(counters.total_ray_tri_intersections <= rays.size() * tris.size());
+}
+}
+
+TEST_CASE("BVH traversal") {
+
+auto logger = std::make_shared<Logger>("", "accel_test.png");
+std::vector<Triangle> tris = uv_sphere(12, 24, 1.f);
+BVH bvh{ tris_bbox(tris), tris, logger, 2 };
+std::vector<Ray> rays = camera_rays(64);
+Interval ray_t{ 0.001f, inf };
+
+SECTION("closest hit matches brute force") {
+    for (const auto& r : rays) {
+        intersection_t isect;
+        intersection_t expected = brute_force_hit(tris, r, ray_t);
+        bool hit = bvh.hit(r, ray_t, isect);
+        REQUIRE(hit == (expected.prim != UINT32_MAX));
+        if (hit) {
+            REQUIRE_THAT(isect.t, Catch::Matchers::WithinRel(expected.t, 1e-4f));
+        }
+    }
+}
+
+SECTION("ray interval is respected") {
+    for (const auto& r : rays) {
+        intersection_t isect;
+        intersection_t expected = brute_force_hit(tris, r, ray_t);
+        if (expected.prim != UINT32_MAX) {
+            REQUIRE(!bvh.hit(r, Interval(ray_t.min(), 0.99f * expected.t), isect));
+        }
+    }
+}
+}
+
+TEST_CASE("Occlusion queries") {
+
+auto logger = std::make_shared<Logger>("", "accel_test.png");
+std::vector<Triangle> tris = uv_sphere(12, 24, 1.f);
+Grid grid{ tris_bbox(tris), tris, logger };
+BVH bvh{ tris_bbox(tris), tris, logger };
+
+objl::Loader loader;
+loader.LoadedMeshes.push_back(to_objl_mesh(tris, Vec3f()));
+MeshList meshes;
+meshes.set_logger(logger);
+meshes.add(loader, geometry_params_t{ .obj_file = "sphere.obj" });
+meshes.build_top_level();
+
+Interval ray_t{ 0.001f, inf };
+
+SECTION("any hit agrees with the closest hit") {
+    for (const auto& r : camera_rays(64)) {
+        intersection_t expected = brute_force_hit(tris, r, ray_t);
+        bool hit = expected.prim != UINT32_MAX;
+        REQUIRE(grid.occluded(r, ray_t) == hit);
+        REQUIRE(bvh.occluded(r, ray_t) == hit);
+        REQUIRE(meshes.occluded(r, ray_t) == hit);
+        if (hit) {
+            // nothing in front of the closest hit
+            Interval before{ ray_t.min(), 0.99f * expected.t };
+            REQUIRE(!grid.occluded(r, before));
+            REQUIRE(!bvh.occluded(r, before));
+            REQUIRE(!meshes.occluded(r, before));
+        }
+    }
+}
+
+SECTION("rays starting inside the bounding box") {
+    // the corners of the bbox lie outside the sphere, a finite
+    // interval ends before the rays leave the bbox
+    Vec3f origin{ 0.9f, 0.9f, 0.9f };
+    for (uint32_t j = 0; j < 16; ++j) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            Vec3f target{ -0.5f + i / 16.f, -0.5f + j / 16.f, 0.f };
+            Ray r{ origin, target - origin };
+            intersection_t expected = brute_force_hit(tris, r, ray_t);
+            REQUIRE(expected.prim != UINT32_MAX);
+
+            Interval through{ ray_t.min(), 1.01f * expected.t };
+            intersection_t grid_isect, bvh_isect;
+            REQUIRE(grid.hit(r, through, grid_isect));
+            REQUIRE(bvh.hit(r, through, bvh_isect));
+            REQUIRE(grid_isect.prim == expected.prim);
+            REQUIRE(bvh_isect.prim == expected.prim);
+            REQUIRE(grid.occluded(r, through));
+            REQUIRE(bvh.occluded(r, through));
+            REQUIRE(meshes.occluded(r, through));
+        }
+    }
+}
+}
+
+TEST_CASE("Triangle tests per ray, Grid vs BVH") {
+    /**
+     * @brief: a small finely tessellated sphere inside the bounding box of
+     * a large far away triangle, the case where the uniform grid resolution
+     * heuristic spends most of its cells on empty space
+     */
+    std::vector<Triangle> tris = uv_sphere(32, 64, 0.2f);
+    tris.emplace_back(
+        vertex_t{ Vec3f(-40.f, -40.f, -40.f), Vec3f(0, 0, 1) },
+        vertex_t{ Vec3f(40.f, -40.f, -40.f), Vec3f(0, 0, 1) },
+        vertex_t{ Vec3f(0.f, 40.f, -40.f), Vec3f(0, 0, 1) },
+        Color(1.f));
+
+    auto grid_logger = std::make_shared<Logger>("", "accel_test.png");
+    auto bvh_logger = std::make_shared<Logger>("", "accel_test.png");
+    Grid grid{ tris_bbox(tris), tris, grid_logger };
+    BVH bvh{ tris_bbox(tris), tris, bvh_logger };
+
+    Interval ray_t{ 0.001f, inf };
+    std::vector<Ray> rays;
+    Vec3f origin{ 0.f, 0.f, 2.f };
+    for (uint32_t j = 0; j < 64; ++j) {
+        for (uint32_t i = 0; i < 64; ++i) {
+            Vec3f target{ -0.3f + 0.6f * i / 64, -0.3f + 0.6f * j / 64, 0.f };
+            rays.emplace_back(origin, target - origin);
+        }
+    }
+
+    for (const auto& r : rays) {
+        intersection_t grid_isect, bvh_isect;
+        bool grid_hit = grid.hit(r, ray_t, grid_isect);
+        bool bvh_hit = bvh.hit(r, ray_t, bvh_isect);
+        REQUIRE(grid_hit == bvh_hit);
+        if (grid_hit) {
+            REQUIRE_THAT(grid_isect.t, Catch::Matchers::WithinRel(bvh_isect.t, 1e-4f));
+        }
+    }
+
+    float grid_tests = static_cast<float>(grid_logger->counters().total_ray_tri_intersections) / rays.size();
+    float bvh_tests = static_cast<float>(bvh_logger->counters().total_ray_tri_intersections) / rays.size();
+    std::cout << "Ray-Triangle tests per ray, grid: " << grid_tests << ", bvh: " << bvh_tests << "\n";
+    REQUIRE(bvh_tests < grid_tests);
+}
+
+TEST_CASE("MeshList top level BVH") {
+    /**
+     * @brief: many small meshes, as loaded from an OBJ file with
+     * lots of groups, traced through the two level hierarchy
+     */
+    auto logger = std::make_shared<Logger>("", "accel_test.png");
+    std::vector<Triangle> sphere = uv_sphere(6, 12, 0.3f);
+    objl::Loader loader;
+    std::vector<Triangle> all_tris;
+    for (int j = -5; j < 5; ++j) {
+        for (int i = -5; i < 5; ++i) {
+            Vec3f offset{ 1.f * i, 1.f * j, -0.5f * ((i + j) % 3) };
+            loader.LoadedMeshes.push_back(to_objl_mesh(sphere, offset));
+            for (const auto& tri : sphere) {
+                all_tris.emplace_back(
+                    vertex_t{ tri.v0().pos + offset, tri.v0().normal },
+                    vertex_t{ tri.v1().pos + offset, tri.v1().normal },
+                    vertex_t{ tri.v2().pos + offset, tri.v2().normal },
+                    Color(1.f));
+            }
+        }
+    }
+
+    MeshList meshes;
+    meshes.set_logger(logger);
+    meshes.add(loader, geometry_params_t{ .obj_file = "spheres.obj", .accel = AccelType::bvh });
+    meshes.build_top_level();
+
+    Interval ray_t{ 0.001f, inf };
+    Vec3f origin{ 0.3f, 0.2f, 8.f };
+    for (uint32_t j = 0; j < 48; ++j) {
+        for (uint32_t i = 0; i < 48; ++i) {
+            Vec3f target{ -6.f + 12.f * i / 48, -6.f + 12.f * j / 48, 0.f };
+            Ray r{ origin, target - origin };
+            intersection_t isect;
+            intersection_t expected = brute_force_hit(all_tris, r, ray_t);
+            bool hit = meshes.hit(r, ray_t, isect);
+            REQUIRE(hit == (expected.prim != UINT32_MAX));
+            if (hit) {
+                REQUIRE_THAT(isect.t, Catch::Matchers::WithinRel(expected.t, 1e-4f));
+            }
+        }
+    }
+}
+
+TEST_CASE("MeshList instancing") {
+    /**
+     * @brief: the same OBJ placed several times shares one object space
+     * mesh, rays are moved to object space when tracing each placement
+     */
+    auto logger = std::make_shared<Logger>("", "accel_test.png");
+    std::vector<Triangle> sphere = uv_sphere(8, 16, 1.f);
+    objl::Loader loader;
+    loader.LoadedMeshes.push_back(to_objl_mesh(sphere, Vec3f()));
+
+    std::vector<geometry_params_t> placements{
+        geometry_params_t{ .obj_file = "sphere.obj", .alpha = 30.f, .beta = 10.f, .scale = 0.5f, .t = Vec3f(-2.f, 0.f, 0.f) },
+        geometry_params_t{ .obj_file = "sphere.obj", .gamma = 45.f, .scale = 1.5f, .t = Vec3f(1.f, 1.f, -2.f) },
+        geometry_params_t{ .obj_file = "sphere.obj", .beta = 70.f, .t = Vec3f(2.5f, -1.5f, 0.5f) }
+    };
+
+    MeshList meshes;
+    meshes.set_logger(logger);
+    std::vector<Triangle> world_tris;
+    for (const auto& g : placements) {
+        if (meshes.has_prototype(g)) {
+            meshes.add(g);
+        } else {
+            meshes.add(loader, g);
+        }
+
+        Mat4 m = frame_transformation(
+            Utils::degs_to_rads(g.alpha), Utils::degs_to_rads(g.beta), Utils::degs_to_rads(g.gamma), g.scale, g.t);
+        Mat4 m_inv = frame_transformation_inv(
+            Utils::degs_to_rads(g.alpha), Utils::degs_to_rads(g.beta), Utils::degs_to_rads(g.gamma), g.scale, g.t);
+        for (const auto& tri : sphere) {
+            auto world_vertex = [&](const vertex_t& v) {
+                return vertex_t{ mat4_vec3_prod(m, v.pos), unit_vector(mat4_normal_prod(m_inv, v.normal)) };
+            };
+            world_tris.emplace_back(world_vertex(tri.v0()), world_vertex(tri.v1()), world_vertex(tri.v2()), Color(1.f));
+        }
+
+        // the inverse must undo the direct transformation
+        Vec3f p{ 0.3f, -0.7f, 1.1f };
+        Vec3f p_back = mat4_vec3_prod(m_inv, mat4_vec3_prod(m, p));
+        REQUIRE_THAT((p_back - p).length(), Catch::Matchers::WithinAbs(0.f, 1e-5f));
+    }
+
+    meshes.build_top_level();
+    REQUIRE(meshes.num_prototypes() == 1);
+    REQUIRE(meshes.num_instances() == placements.size());
+
+    Interval ray_t{ 0.001f, inf };
+    Vec3f origin{ 0.2f, 0.1f, 8.f };
+    for (uint32_t j = 0; j < 48; ++j) {
+        for (uint32_t i = 0; i < 48; ++i) {
+            Vec3f target{ -4.f + 8.f * i / 48, -4.f + 8.f * j / 48, 0.f };
+            Ray r{ origin, target - origin };
+            intersection_t isect;
+            intersection_t expected = brute_force_hit(world_tris, r, ray_t);
+            bool hit = meshes.hit(r, ray_t, isect);
+            REQUIRE(hit == (expected.prim != UINT32_MAX));
+            if (hit) {
+                // object space triangle ids are shared by all the instances
+                REQUIRE(isect.prim == expected.prim % sphere.size());
+
+                HitRecord rec = meshes.hit_record(r, isect);
+                REQUIRE_THAT(rec.get_t(), Catch::Matchers::WithinRel(expected.t, 1e-4f));
+                REQUIRE_THAT((rec.get_hit_point() - r.at(expected.t)).length(), Catch::Matchers::WithinAbs(0.f, 1e-3f));
+                REQUIRE_THAT(rec.get_normal().length(), Catch::Matchers::WithinRel(1.f, 1e-4f));
+            }
+        }
+    }
+}
+
+typedef struct TestPacket {
+    ray_packet_t packet;
+    std::vector<Ray> rays; // the rays pushed in the packet, in lane order
+} test_packet_t;
+
+static std::vector<test_packet_t> packets_of(const std::vector<Ray>& rays, uint32_t n, uint32_t side, const Interval& ray_t) {
+    /**
+     * @brief: the n x n rays, sharing their origin, in packets of side x side rays
+     */
+    std::vector<test_packet_t> packets;
+    for (uint32_t y0 = 0; y0 < n; y0 += side) {
+        for (uint32_t x0 = 0; x0 < n; x0 += side) {
+            test_packet_t& p = packets.emplace_back();
+            RayPackets::start(p.packet);
+            for (uint32_t j = y0; j < std::min(y0 + side, n); ++j) {
+                for (uint32_t i = x0; i < std::min(x0 + side, n); ++i) {
+                    RayPackets::push(p.packet, rays[j * n + i], ray_t.min(), ray_t.max());
+                    p.rays.push_back(rays[j * n + i]);
+                }
+            }
+            RayPackets::close(p.packet);
+        }
+    }
+
+    return packets;
+}
+
+TEST_CASE("Packet traversal") {
+
+auto logger = std::make_shared<Logger>("", "accel_test.png");
+std::vector<Triangle> tris = uv_sphere(12, 24, 1.f);
+Grid grid{ tris_bbox(tris), tris, logger };
+Interval ray_t{ 0.001f, inf };
+
+auto require_single_ray_hits = [&](const std::vector<test_packet_t>& packets, const Interval& t) {
+    for (const auto& [packet, rays] : packets) {
+        for (uint32_t k = 0; k < packet.size; ++k) {
+            intersection_t expected;
+            bool hit = grid.hit(rays[k], t, expected);
+            REQUIRE((packet.prim[k] != UINT32_MAX) == hit);
+            if (hit) {
+                REQUIRE(packet.prim[k] == expected.prim);
+                REQUIRE_THAT(packet.t[k], Catch::Matchers::WithinRel(expected.t, 1e-5f));
+            }
+        }
+    }
+};
+
+SECTION("coherent packets match single rays") {
+    // 7 does not divide 64, the packets at the edges are partial
+    for (uint32_t side : { 4u, 7u, 8u }) {
+        std::vector<test_packet_t> packets = packets_of(camera_rays(64), 64, side, ray_t);
+        for (auto& [packet, rays] : packets) {
+            uint64_t hits = grid.hit(packet);
+            for (uint32_t k = 0; k < packet.size; ++k) {
+                REQUIRE(((hits >> k) & 1) == (packet.prim[k] != UINT32_MAX));
+            }
+        }
+        require_single_ray_hits(packets, ray_t);
+    }
+}
+
+SECTION("ray interval is respected") {
+    Interval short_t{ ray_t.min(), 2.5f };
+    std::vector<test_packet_t> packets = packets_of(camera_rays(64), 64, 8, short_t);
+    for (auto& [packet, rays] : packets) {
+        grid.hit(packet);
+        for (uint32_t k = 0; k < packet.size; ++k) {
+            REQUIRE(packet.t[k] <= short_t.max());
+        }
+    }
+    require_single_ray_hits(packets, short_t);
+}
+
+SECTION("diverging rays from inside the grid") {
+    // rays going every way have no main axis, they are traced one at a time
+    std::vector<Ray> rays;
+    for (uint32_t j = 0; j < 8; ++j) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            float theta = std::numbers::pi_v<float> * (j + 0.5f) / 8;
+            float phi = 2.f * std::numbers::pi_v<float> * i / 8;
+            rays.emplace_back(Vec3f(0.1f, 0.f, 0.f), Vec3f(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+
+    std::vector<test_packet_t> packets = packets_of(rays, 8, 8, ray_t);
+    REQUIRE(std::popcount(grid.hit(packets[0].packet)) == 64);
+    require_single_ray_hits(packets, ray_t);
+}
+
+SECTION("instanced grids through the top level") {
+    objl::Loader loader;
+    loader.LoadedMeshes.push_back(to_objl_mesh(uv_sphere(8, 16, 1.f), Vec3f()));
+    MeshList meshes;
+    meshes.set_logger(logger);
+    meshes.add(loader, geometry_params_t{ .obj_file = "sphere.obj", .alpha = 30.f, .scale = 0.5f, .t = Vec3f(-0.5f, 0.f, 0.f) });
+    meshes.add(geometry_params_t{ .obj_file = "sphere.obj", .gamma = 45.f, .scale = 1.5f, .t = Vec3f(1.f, 1.f, -2.f) });
+    meshes.build_top_level();
+    REQUIRE(meshes.packet_traversal());
+
+    std::vector<test_packet_t> packets = packets_of(camera_rays(64), 64, 8, ray_t);
+    for (auto& [packet, rays] : packets) {
+        meshes.hit(packet);
+        for (uint32_t k = 0; k < packet.size; ++k) {
+            intersection_t expected;
+            bool hit = meshes.hit(rays[k], ray_t, expected);
+            REQUIRE((packet.instance[k] != UINT32_MAX) == hit);
+            if (hit) {
+                REQUIRE(packet.instance[k] == expected.instance);
+                REQUIRE(packet.prim[k] == expected.prim);
+                REQUIRE_THAT(packet.t[k], Catch::Matchers::WithinRel(expected.t, 1e-5f));
+            }
+        }
+    }
+}
+}
\ No newline at end of file
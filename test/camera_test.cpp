@@ -0,0 +1,142 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <filesystem>
+#include <random>
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "logger.h"
+
+static void write_file(const std::filesystem::path& path, const std::string& text) {
+    std::ofstream file(path);
+    file << text;
+}
+
+class ScratchDir {
+    /**
+     * @brief: fresh directory under the system temp directory, made the
+     * working directory for the lifetime of the object
+     * @details: the previous working directory is restored and the
+     * directory removed on destruction, also when a REQUIRE throws
+     */
+private:
+    std::filesystem::path _prev;
+    std::filesystem::path _dir;
+
+public:
+    ScratchDir(const std::string& prefix) : _prev(std::filesystem::current_path()) {
+        std::random_device rd;
+        do {
+            _dir = std::filesystem::temp_directory_path() / (prefix + std::to_string(rd()));
+        } while (!std::filesystem::create_directory(_dir));
+        std::filesystem::current_path(_dir);
+    }
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+    ~ScratchDir() {
+        std::error_code ec;
+        std::filesystem::current_path(_prev, ec);
+        std::filesystem::remove_all(_dir, ec);
+    }
+}; // class ScratchDir
+
+static init_params_t tiny_init_pars(EngineType engine) {
+    init_params_t p{};
+    p.img_width = 24;
+    p.img_height = 16;
+    p.window_width = p.img_width;
+    p.window_height = p.img_height;
+    p.depth = 6;
+    p.rr_depth = 2;
+    p.samples_per_pixel = 4;
+    p.samples_per_pass = 0;
+    p.min_samples_per_pixel = 0;
+    p.adaptive_threshold = 0.f;
+    p.threads = 1;
+    p.tile_size = 8;
+    p.headless = true;
+    p.max_fps = 0;
+    p.sampler = SamplerType::sobol;
+    p.tonemap = TonemapType::none;
+    p.engine = engine;
+    p.packet_size = 4;
+    p.vfov = 60.f;
+    p.focus_dist = 1.f;
+    p.lookfrom = Vec3f(0.f, 0.5f, 3.f);
+    p.lookat = Vec3f(0.f, 0.f, 0.f);
+    p.background = Color(0.1f, 0.1f, 0.2f);
+    p.environment_map = "";
+    p.outfile_name = "camera_test";
+
+    return p;
+}
+
+static AccumBuffer render(EngineType engine, const std::vector<geometry_params_t>& geometries) {
+    init_params_t pars = tiny_init_pars(engine);
+    Camera camera{ pars, camera_angles_t{}, geometries, std::make_shared<Logger>("", "camera_test.png") };
+    camera.set_meshes();
+
+    AccumBuffer accum{ pars.img_width, pars.img_height };
+    for (uint32_t y0 = 0; y0 < pars.img_height; y0 += pars.tile_size) {
+        for (uint32_t x0 = 0; x0 < pars.img_width; x0 += pars.tile_size) {
+            tile_t tile{ x0, y0, std::min(x0 + pars.tile_size, pars.img_width), std::min(y0 + pars.tile_size, pars.img_height) };
+            camera.render_tile(tile, pars.samples_per_pixel, accum);
+        }
+    }
+
+    return accum;
+}
+
+static void require_equal(const AccumBuffer& a, const AccumBuffer& b) {
+    for (uint32_t j = 0; j < a.height(); ++j) {
+        for (uint32_t i = 0; i < a.width(); ++i) {
+            REQUIRE(a.samples(i, j) == b.samples(i, j));
+            Color ca = a.average(i, j);
+            Color cb = b.average(i, j);
+            REQUIRE(ca.x() == cb.x());
+            REQUIRE(ca.y() == cb.y());
+            REQUIRE(ca.z() == cb.z());
+        }
+    }
+}
+
+TEST_CASE("Megakernel and wavefront engines") {
+    ScratchDir scratch{ "camera_test_" }; // meshes are loaded from init/meshes under the working directory
+    const std::filesystem::path dir{ "init/meshes" };
+    std::filesystem::create_directories(dir);
+    write_file(dir / "camera_test_floor.obj",
+        "mtllib camera_test_floor.mtl\nusemtl mat_floor\no floor\n"
+        "v -2 0 -2\nv 2 0 -2\nv 2 0 2\nv -2 0 2\nv -0.3 0 -0.5\nv 0.5 0 -0.3\nv 0 1 -0.4\n"
+        "f 1 3 2\nf 1 4 3\nf 5 6 7\n");
+    write_file(dir / "camera_test_floor.mtl", "newmtl mat_floor\nKd 0.7 0.6 0.5\n");
+    write_file(dir / "camera_test_light.obj",
+        "mtllib camera_test_light.mtl\nusemtl mat_light\no light\n"
+        "v -0.5 0 -0.5\nv 0.5 0 -0.5\nv 0.5 0 0.5\nv -0.5 0 0.5\nf 1 2 3\nf 1 3 4\n");
+    write_file(dir / "camera_test_light.mtl", "newmtl mat_light\nKd 0 0 0\nKe 10 10 10\n");
+
+    geometry_params_t floor{ "camera_test_floor.obj" };
+    geometry_params_t light{ "camera_test_light.obj" };
+    light.t = Vec3f(0.f, 1.5f, 0.f);
+
+    SECTION("grid meshes, camera rays traced in packets") {
+        std::vector<geometry_params_t> geometries{ floor, light };
+        AccumBuffer mk = render(EngineType::megakernel, geometries);
+        AccumBuffer wf = render(EngineType::wavefront, geometries);
+
+        require_equal(mk, wf);
+    }
+
+    SECTION("bvh and grid meshes, rays traced one at a time") {
+        light.accel = AccelType::bvh;
+        std::vector<geometry_params_t> geometries{ floor, light };
+        AccumBuffer mk = render(EngineType::megakernel, geometries);
+        AccumBuffer wf = render(EngineType::wavefront, geometries);
+
+        require_equal(mk, wf);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <numbers>
+#include <filesystem>
+
+#include "envmap.h"
+#include "random.h"
+
+TEST_CASE("Environment map") {
+    const uint32_t w = 16;
+    const uint32_t h = 8;
+    std::vector<Color> texels(w * h, Color(0.5f, 0.5f, 0.5f));
+    for (uint32_t i = 0; i < w; ++i) {
+        texels[i] = Color(0.f, 0.f, 1.f); // top row
+        texels[(h - 1) * w + i] = Color(0.f, 1.f, 0.f); // bottom row
+    }
+    const uint32_t sun = 3 * w + w / 2; // just above the horizon, looking along -z
+    texels[sun] = Color(1000.f, 1000.f, 1000.f);
+    EnvironmentMap env{ w, h, texels };
+
+    SECTION("directions map to the equirectangular texels") {
+        REQUIRE(env.eval(Vec3f(0.f, 1.f, 0.01f)).z() == 1.f);
+        REQUIRE(env.eval(Vec3f(0.f, -1.f, 0.01f)).y() == 1.f);
+        float theta = std::numbers::pi_v<float> * 3.5f / h;
+        REQUIRE(env.eval(Vec3f(0.01f, std::cos(theta), -std::sin(theta))).x() == 1000.f);
+        REQUIRE(env.eval(Vec3f(0.01f, std::cos(theta), std::sin(theta))).x() == 0.5f);
+    }
+
+    SECTION("the pdf integrates to 1 over the sphere") {
+        RandomUtils::Pcg32 rng{ 7, 0 };
+        const uint32_t n = 1 << 18;
+        double sum{ 0 };
+        for (uint32_t k = 0; k < n; ++k) {
+            float z = 1.f - 2.f * rng.next_float();
+            float r = std::sqrt(std::max(0.f, 1.f - z * z));
+            float phi = 2.f * std::numbers::pi_v<float> * rng.next_float();
+            sum += env.pdf(Vec3f(r * std::cos(phi), r * std::sin(phi), z));
+        }
+
+        REQUIRE_THAT(sum / n * 4.0 * std::numbers::pi, Catch::Matchers::WithinAbs(1.0, 0.02));
+    }
+
+    SECTION("bright texels are sampled more and the estimate is unbiased") {
+        // integral of the luminance over the sphere, texel by texel
+        double exact{ 0 };
+        for (uint32_t j = 0; j < h; ++j) {
+            double band = 2.0 * std::numbers::pi * (std::cos(std::numbers::pi * j / h) - std::cos(std::numbers::pi * (j + 1) / h)) / w;
+            for (uint32_t i = 0; i < w; ++i) {
+                exact += luminance(texels[j * w + i]) * band;
+            }
+        }
+
+        const uint32_t n = 1 << 14;
+        double sum{ 0 };
+        uint32_t in_sun{ 0 };
+        for (uint32_t k = 0; k < n; ++k) {
+            float u = (k + 0.5f) / n;
+            env_sample_t s = env.sample(u, { std::fmod(u * 977.f, 1.f), std::fmod(u * 331.f, 1.f) });
+            REQUIRE_THAT(s.dir.length(), Catch::Matchers::WithinAbs(1.f, 1e-5f));
+            REQUIRE(s.pdf == env.pdf(s.dir));
+            in_sun += s.radiance.x() == 1000.f;
+            sum += luminance(s.radiance) / s.pdf;
+        }
+
+        REQUIRE(in_sun > n / 2);
+        REQUIRE_THAT(sum / n, Catch::Matchers::WithinRel(exact, 0.02));
+    }
+}
+
+TEST_CASE("Environment map files") {
+    SECTION("pfm rows are stored bottom to top") {
+        const std::string path = "envmap_test.pfm";
+        {
+            std::ofstream file{ path, std::ios::binary };
+            file << "PF\n2 2\n-1.0\n";
+            const float raster[] = { 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f };
+            file.write(reinterpret_cast<const char*>(raster), sizeof(raster));
+        }
+
+        EnvironmentMap env{ path };
+        REQUIRE(env.width() == 2);
+        REQUIRE(env.height() == 2);
+        // bottom left texel, the first of the file
+        Color c = env.eval(Vec3f(-0.01f, -1.f, -0.01f));
+        REQUIRE(c.x() == 1.f);
+        REQUIRE(c.z() == 3.f);
+        // top right texel, the last of the file
+        REQUIRE(env.eval(Vec3f(0.01f, 1.f, -0.01f)).y() == 11.f);
+        std::filesystem::remove(path);
+    }
+
+    SECTION("run length encoded hdr scanlines") {
+        const std::string path = "envmap_test.hdr";
+        const uint32_t w = 8;
+        {
+            std::ofstream file{ path, std::ios::binary };
+            file << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 1 +X 8\n";
+            file.put(2).put(2).put(0).put(static_cast<char>(w));
+            // r: a run of 8, g: 8 literals, b: a run of 8, e: a run of 8
+            file.put(static_cast<char>(128 + w)).put(static_cast<char>(128));
+            file.put(static_cast<char>(w));
+            for (uint32_t i = 0; i < w; ++i) {
+                file.put(static_cast<char>(16 * i));
+            }
+            file.put(static_cast<char>(128 + w)).put(0);
+            file.put(static_cast<char>(128 + w)).put(static_cast<char>(129));
+        }
+
+        EnvironmentMap env{ path };
+        REQUIRE(env.width() == w);
+        REQUIRE(env.height() == 1);
+        // exponent 129 scales the mantissas by 2 / 256
+        for (uint32_t i = 0; i < w; ++i) {
+            float phi = ((i + 0.5f) / w - 0.5f) * 2.f * std::numbers::pi_v<float>;
+            Color c = env.eval(Vec3f(std::sin(phi), 0.f, -std::cos(phi)));
+            REQUIRE(c.x() == 1.f);
+            REQUIRE(c.y() == 16.f * i * 2.f / 256.f);
+            REQUIRE(c.z() == 0.f);
+        }
+        std::filesystem::remove(path);
+    }
+
+    SECTION("unknown extensions are rejected") {
+        REQUIRE_THROWS_AS(EnvironmentMap{ "sky.png" }, std::runtime_error);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <vector>
+#include <iterator>
+
+#include "framebuffer.h"
+#include "interval.h"
+
+TEST_CASE("Accumulation buffer") {
+    const uint32_t w = 8;
+    const uint32_t h = 6;
+    AccumBuffer accum{ w, h };
+
+    SECTION("averages use the pixel's own sample count") {
+        accum.add(1, 2, Color(1.f, 0.5f, 0.f));
+        accum.add(1, 2, Color(0.f, 0.5f, 1.f));
+        accum.add(3, 4, Color(0.2f, 0.2f, 0.2f));
+
+        REQUIRE(accum.samples(1, 2) == 2);
+        REQUIRE(accum.samples(3, 4) == 1);
+        REQUIRE(accum.samples(0, 0) == 0);
+        REQUIRE_THAT(accum.average(1, 2).x(), Catch::Matchers::WithinAbs(0.5f, 1e-6f));
+        REQUIRE_THAT(accum.average(1, 2).y(), Catch::Matchers::WithinAbs(0.5f, 1e-6f));
+        REQUIRE_THAT(accum.average(3, 4).z(), Catch::Matchers::WithinAbs(0.2f, 1e-6f));
+        REQUIRE(accum.average(0, 0).x() == 0.f);
+        REQUIRE(accum.total_samples() == 3);
+    }
+
+    SECTION("error estimate") {
+        REQUIRE(accum.error(0, 0) == inf);
+        for (uint32_t s = 0; s < 8; ++s) {
+            accum.add(0, 0, Color(0.3f, 0.3f, 0.3f));
+            accum.add(1, 0, Color(s % 2, s % 2, s % 2));
+        }
+
+        REQUIRE_THAT(accum.error(0, 0), Catch::Matchers::WithinAbs(0.f, 1e-3f));
+        REQUIRE(accum.error(1, 0) > 0.1f);
+
+        float e8 = accum.error(1, 0);
+        for (uint32_t s = 0; s < 24; ++s) {
+            accum.add(1, 0, Color(s % 2, s % 2, s % 2));
+        }
+        REQUIRE(accum.error(1, 0) < 0.6f * e8);
+    }
+
+    SECTION("every pixel is sampled up to max_samples without a threshold") {
+        REQUIRE(accum.update_active(4, 2, 0.f) == w * h);
+        for (uint32_t j = 0; j < h; ++j) {
+            for (uint32_t i = 0; i < w; ++i) {
+                for (uint32_t s = 0; s < 4; ++s) {
+                    accum.add(i, j, Color(s % 2, 0.f, 0.f));
+                }
+            }
+        }
+
+        REQUIRE(accum.update_active(4, 2, 0.f) == 0);
+    }
+
+    SECTION("tiles are complete once all their pixels reach max_samples") {
+        tile_t tile{ 2, 1, 5, 4 };
+        for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+            for (uint32_t i = tile.x0; i < tile.x1; ++i) {
+                accum.add(i, j, Color(0.5f, 0.5f, 0.5f));
+            }
+        }
+        REQUIRE(accum.complete(tile, 1));
+        REQUIRE_FALSE(accum.complete(tile, 2));
+        REQUIRE_FALSE(accum.complete(tile_t{ 1, 1, 5, 4 }, 1));
+    }
+
+    SECTION("noisy pixels keep their neighbourhood active") {
+        auto pass = [&](uint32_t n) {
+            for (uint32_t j = 0; j < h; ++j) {
+                for (uint32_t i = 0; i < w; ++i) {
+                    if (!accum.active(i, j)) {
+                        continue;
+                    }
+                    for (uint32_t s = 0; s < n; ++s) {
+                        float c = (i == 4 && j == 3) ? (accum.samples(i, j) % 2) : 0.5f;
+                        accum.add(i, j, Color(c, c, c));
+                    }
+                }
+            }
+        };
+
+        const uint32_t max_spp = 64;
+        const uint32_t min_spp = 4;
+        const float threshold = 0.01f;
+        REQUIRE(accum.update_active(max_spp, min_spp, threshold) == w * h);
+        pass(2);
+        REQUIRE(accum.update_active(max_spp, min_spp, threshold) == w * h); // below min_samples
+        pass(2);
+
+        // only the noisy pixel and its 3x3 neighbourhood are left
+        REQUIRE(accum.update_active(max_spp, min_spp, threshold) == 9);
+        for (uint32_t j = 0; j < h; ++j) {
+            for (uint32_t i = 0; i < w; ++i) {
+                bool near = i >= 3 && i <= 5 && j >= 2 && j <= 4;
+                REQUIRE(accum.active(i, j) == near);
+            }
+        }
+
+        while (accum.update_active(max_spp, min_spp, threshold) > 0) {
+            pass(4);
+        }
+
+        REQUIRE(accum.samples(4, 3) == max_spp);
+        REQUIRE(accum.samples(0, 0) == min_spp);
+    }
+}
+
+TEST_CASE("Framebuffer") {
+    const uint32_t w = 37;
+    const uint32_t h = 20;
+    const uint32_t tile_size = 16;
+    Framebuffer fb{ w, h, tile_size };
+
+    SECTION("rows start on a cache line") {
+        REQUIRE(fb.pitch() >= w);
+        REQUIRE(fb.pitch() % 16 == 0);
+        for (uint32_t j = 0; j < h; ++j) {
+            REQUIRE(reinterpret_cast<uintptr_t>(fb.row(j)) % 64 == 0);
+        }
+    }
+
+    SECTION("tile rectangles clipped to the image") {
+        for (uint32_t t = 0; t < fb.num_tiles(); ++t) {
+            tile_t tile = fb.tile(t);
+            REQUIRE(fb.tile_index(tile) == t);
+            REQUIRE(tile.x1 <= w);
+            REQUIRE(tile.y1 <= h);
+        }
+
+        tile_t corner = fb.tile(5);
+        REQUIRE(corner.x0 == 32);
+        REQUIRE(corner.y0 == 16);
+        REQUIRE(corner.width() == 5);
+        REQUIRE(corner.height() == 4);
+    }
+
+    SECTION("published tiles are taken once") {
+        REQUIRE(fb.num_tiles() == 3 * 2);
+        std::vector<uint32_t> taken;
+        REQUIRE(fb.take_dirty(std::back_inserter(taken), fb.num_tiles()) == 0);
+
+        tile_t tile{ 32, 16, 37, 20 };
+        fb.row(19)[36] = 0xffffffffu;
+        fb.publish(tile);
+        fb.publish(tile);
+        fb.publish(tile_t{ 0, 0, 16, 16 });
+        REQUIRE(fb.tile_index(tile) == 5);
+        REQUIRE(fb.take_dirty(std::back_inserter(taken), fb.num_tiles()) == 2);
+        REQUIRE(taken == std::vector<uint32_t>{ 5, 0 });
+        REQUIRE(fb.data()[19 * fb.pitch() + 36] == 0xffffffffu);
+
+        taken.clear();
+        REQUIRE(fb.take_dirty(std::back_inserter(taken), fb.num_tiles()) == 0);
+        fb.publish(tile);
+        REQUIRE(fb.take_dirty(std::back_inserter(taken), fb.num_tiles()) == 1);
+    }
+}
\ No newline at end of file
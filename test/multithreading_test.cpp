@@ -3,8 +3,12 @@
 #include <catch2/catch_all.hpp>
 #include <iostream>
 #include <future>
+#include <algorithm>
+#include <iterator>
+#include <string>
 
 #include "multithreading.h"
+#include "scheduler.h"
 
 typedef struct TestStruct {
         int n = 0;
@@ -190,3 +194,230 @@ SECTION("try_pop() test") {
     }
 }
 }
+
+TEST_CASE("WorkStealingQueue owner and thief ends") {
+
+WorkStealingQueue<int> q;
+
+SECTION("try_pop() takes from the front, try_steal() from the back") {
+    REQUIRE(q.empty());
+    REQUIRE(!q.try_pop());
+    REQUIRE(!q.try_steal());
+
+    for (int i = 0; i < 4; ++i) {
+        q.push(int{ i });
+    }
+
+    REQUIRE(q.try_pop().value() == 0);
+    REQUIRE(q.try_steal().value() == 3);
+    REQUIRE(q.try_pop().value() == 1);
+    REQUIRE(q.try_steal().value() == 2);
+    REQUIRE(q.empty());
+}
+
+SECTION("concurrent owner and thieves take every item exactly once") {
+    const int n_items = 10000;
+    for (int i = 0; i < n_items; ++i) {
+        q.push(int{ i });
+    }
+
+    std::vector<std::atomic<int>> taken(n_items);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        while (auto i = q.try_pop()) {
+            ++taken[i.value()];
+        }
+    });
+    for (int t = 0; t < 3; ++t) {
+        threads.emplace_back([&] {
+            while (auto i = q.try_steal()) {
+                ++taken[i.value()];
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (const auto& c : taken) {
+        REQUIRE(c == 1);
+    }
+}
+}
+
+TEST_CASE("MpscRingBuffer single thread") {
+
+MpscRingBuffer<test_struct_t> q{ 5 };
+
+SECTION("capacity, try_push() on a full buffer") {
+    REQUIRE(q.capacity() == 8);
+    REQUIRE(q.empty());
+    REQUIRE(!q.try_pop());
+
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE(q.try_push(test_struct_t{ i, std::vector<double>(3, i + 0.5) }));
+    }
+
+    test_struct_t s{ 8, std::vector<double>(3, 8.5) };
+    REQUIRE(!q.try_push(std::move(s)));
+    REQUIRE(s.vec.size() == 3); // not moved from
+
+    auto res = q.try_pop();
+    REQUIRE(res->n == 0);
+    REQUIRE(res->vec[0] == 0.5);
+    REQUIRE(q.try_push(std::move(s)));
+}
+
+SECTION("try_pop_batch() keeps the push order across laps") {
+    std::vector<test_struct_t> out;
+    int next_push{ 0 };
+    int next_pop{ 0 };
+    for (int lap = 0; lap < 10; ++lap) {
+        while (q.try_push(test_struct_t{ next_push, {} })) {
+            ++next_push;
+        }
+
+        REQUIRE(q.try_pop_batch(std::back_inserter(out), 3) == 3);
+        REQUIRE(q.try_pop_batch(std::back_inserter(out), 100) == 5);
+        REQUIRE(q.empty());
+        for (const auto& s : out) {
+            REQUIRE(s.n == next_pop++);
+        }
+        out.clear();
+    }
+
+    REQUIRE(next_pop == 80);
+}
+}
+
+TEST_CASE("MpscRingBuffer multithreaded") {
+
+SECTION("every item pushed by many producers is popped exactly once") {
+    const int n_producers = 8;
+    const int n_items = 20000;
+    MpscRingBuffer<int> q{ 64 }; // small, producers often find it full
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < n_producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = p; i < n_items; i += n_producers) {
+                q.push(int{ i });
+            }
+        });
+    }
+
+    std::vector<int> taken(n_items, 0);
+    std::vector<int> last(n_producers, -1);
+    int popped{ 0 };
+    int batch[16];
+    while (popped < n_items) {
+        size_t n = q.try_pop_batch(batch, 16);
+        for (size_t k = 0; k < n; ++k) {
+            ++taken[batch[k]];
+            // items of the same producer come out in order
+            REQUIRE(batch[k] > last[batch[k] % n_producers]);
+            last[batch[k] % n_producers] = batch[k];
+        }
+        popped += n;
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    REQUIRE(q.empty());
+    REQUIRE(std::all_of(taken.begin(), taken.end(), [](int c) { return c == 1; }));
+}
+}
+
+template<typename Push, typename Drain>
+static void contention_run(int n_producers, int n_items, Push push, Drain drain) {
+    /**
+     * @brief: n_producers threads push n_items in total while
+     * the calling thread pops them
+     */
+    std::vector<std::thread> threads;
+    for (int p = 0; p < n_producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = p; i < n_items; i += n_producers) {
+                push(i);
+            }
+        });
+    }
+
+    int popped{ 0 };
+    while (popped < n_items) {
+        int n = drain();
+        if (n == 0) {
+            std::this_thread::yield(); // lets the producers run when they outnumber the cores
+        }
+        popped += n;
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+TEST_CASE("Queue contention, ThreadSafeQueue vs MpscRingBuffer", "[.][benchmark]") {
+    // hidden from the default run, select it with the [benchmark] tag
+    const int n_items = 1 << 16;
+    for (int n_producers : { 1, 2, 4, 8, 16, 32, 64 }) {
+        BENCHMARK("ThreadSafeQueue, try_pop(), producers: " + std::to_string(n_producers)) {
+            ThreadSafeQueue<int> q;
+            contention_run(n_producers, n_items,
+                [&](int i) { q.push(int{ i }); },
+                [&]() { return q.try_pop() ? 1 : 0; });
+
+            return q.empty();
+        };
+
+        BENCHMARK("MpscRingBuffer, try_pop_batch(), producers: " + std::to_string(n_producers)) {
+            MpscRingBuffer<int> q{ 4096 };
+            int batch[256];
+            contention_run(n_producers, n_items,
+                [&](int i) { q.push(int{ i }); },
+                [&]() { return static_cast<int>(q.try_pop_batch(batch, 256)); });
+
+            return q.empty();
+        };
+    }
+}
+
+TEST_CASE("RenderScheduler covers the image") {
+
+const uint32_t width = 100;
+const uint32_t height = 37;
+std::atomic<bool> cancel{ false };
+
+SECTION("every pixel is rendered exactly once") {
+    RenderScheduler scheduler{ width, height, 16, 4 };
+    REQUIRE(scheduler.num_threads() == 4);
+    REQUIRE(scheduler.num_tiles() == 7 * 3);
+
+    std::vector<std::atomic<int>> pixels(width * height);
+    scheduler.run([&](const tile_t& tile) {
+        for (uint32_t j = tile.y0; j < tile.y1; ++j) {
+            for (uint32_t i = tile.x0; i < tile.x1; ++i) {
+                ++pixels[i + j * width];
+            }
+        }
+    }, cancel);
+
+    for (const auto& p : pixels) {
+        REQUIRE(p == 1);
+    }
+}
+
+SECTION("cancelled run stops handing out tiles") {
+    RenderScheduler scheduler{ width, height, 8, 2 };
+    std::atomic<uint32_t> rendered{ 0 };
+    scheduler.run([&](const tile_t&) {
+        ++rendered;
+        cancel = true;
+    }, cancel);
+
+    REQUIRE(rendered <= scheduler.num_threads());
+}
+}
\ No newline at end of file
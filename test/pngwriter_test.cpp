@@ -0,0 +1,233 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <algorithm>
+
+#include "pngwriter.h"
+#include "framebuffer.h"
+#include "random.h"
+
+namespace {
+uint32_t adler32(const std::vector<uint8_t>& data) {
+    uint32_t a{ 1 };
+    uint32_t b{ 0 };
+    for (uint8_t byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream file{ path, std::ios::binary };
+
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+struct BitReader {
+    const std::vector<uint8_t>& data;
+    size_t bit{ 16 }; // past the zlib header
+
+    uint32_t get(uint32_t count) {
+        // deflate packs values starting from their least significant bit
+        uint32_t value{ 0 };
+        for (uint32_t k = 0; k < count; ++k, ++bit) {
+            if (bit / 8 < data.size()) {
+                value |= ((data[bit / 8] >> (bit % 8)) & 1u) << k;
+            }
+        }
+
+        return value;
+    }
+
+    uint32_t get_huffman(uint32_t length) {
+        uint32_t code{ 0 };
+        for (uint32_t k = 0; k < length; ++k) {
+            code = (code << 1) | get(1);
+        }
+
+        return code;
+    }
+
+    bool overrun() const { return bit > 8 * data.size(); }
+};
+
+uint32_t get_literal(BitReader& in) {
+    // fixed literal/length code, RFC 1951 3.2.6
+    uint32_t code = in.get_huffman(7);
+    if (code <= 23) {
+        return 256 + code;
+    }
+    code = (code << 1) | in.get(1);
+    if (code >= 0x30 && code <= 0xbf) {
+        return code - 0x30;
+    }
+    if (code >= 0xc0 && code <= 0xc7) {
+        return 280 + code - 0xc0;
+    }
+    code = (code << 1) | in.get(1);
+
+    return 144 + code - 0x190;
+}
+
+std::vector<uint8_t> inflate(const std::vector<uint8_t>& stream, uint32_t& max_dist) {
+    /**
+     * @brief: decoder of the fixed Huffman blocks Deflater writes, checks
+     * the compressed body independently of the encoder
+     * @return: the decoded data, empty if the stream is malformed
+     */
+    static constexpr uint16_t len_base[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr uint8_t len_extra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr uint16_t dist_base[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static constexpr uint8_t dist_extra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    BitReader in{ stream };
+    std::vector<uint8_t> out;
+    max_dist = 0;
+    bool last{ false };
+    while (!last) {
+        last = in.get(1);
+        if (in.get(2) != 1) {
+            return {};
+        }
+
+        for (uint32_t symbol = get_literal(in); symbol != 256; symbol = get_literal(in)) {
+            if (in.overrun()) {
+                return {};
+            }
+            if (symbol < 256) {
+                out.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+
+            uint32_t l = symbol - 257;
+            if (l >= 29) {
+                return {};
+            }
+            uint32_t length = len_base[l] + in.get(len_extra[l]);
+            uint32_t d = in.get_huffman(5);
+            if (d >= 30) {
+                return {};
+            }
+            uint32_t dist = dist_base[d] + in.get(dist_extra[d]);
+            if (dist > out.size() || dist > 32768) {
+                return {};
+            }
+            max_dist = std::max(max_dist, dist);
+            for (uint32_t k = 0; k < length; ++k) {
+                out.push_back(out[out.size() - dist]);
+            }
+        }
+    }
+
+    // the adler-32 trailer fills the bytes after the last block
+    if ((in.bit + 7) / 8 + 4 != stream.size()) {
+        return {};
+    }
+
+    return out;
+}
+
+std::vector<uint8_t> deflate(const std::vector<uint8_t>& input, size_t piece) {
+    Deflater deflater;
+    std::vector<uint8_t> stream;
+    for (size_t k = 0; k < input.size(); k += piece) {
+        auto out = deflater.compress(input.data() + k, std::min(piece, input.size() - k));
+        stream.insert(stream.end(), out.begin(), out.end());
+    }
+    auto tail = deflater.finish();
+    stream.insert(stream.end(), tail.begin(), tail.end());
+
+    return stream;
+}
+
+uint32_t be32(const std::vector<uint8_t>& data, size_t pos) {
+    return (static_cast<uint32_t>(data[pos]) << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+}
+} // namespace
+
+TEST_CASE("Deflater") {
+    std::vector<uint8_t> input(100000);
+    for (size_t k = 0; k < input.size(); ++k) {
+        input[k] = static_cast<uint8_t>((k / 7) % 23);
+    }
+
+    std::vector<uint8_t> stream = deflate(input, 30000);
+
+    SECTION("zlib header and adler-32 trailer") {
+        REQUIRE(stream[0] == 0x78);
+        REQUIRE((stream[0] * 256 + stream[1]) % 31 == 0);
+        REQUIRE(be32(stream, stream.size() - 4) == adler32(input));
+    }
+
+    SECTION("repeated input is compressed") {
+        REQUIRE(stream.size() < input.size() / 10);
+    }
+
+    SECTION("the stream inflates back to the input") {
+        uint32_t max_dist{ 0 };
+        REQUIRE(inflate(stream, max_dist) == input);
+    }
+
+    SECTION("matches reach back into earlier pieces up to the window size") {
+        // random bytes leave hardly anything to match but the copied runs,
+        // one exactly a window back and one past the window
+        RandomUtils::Pcg32 rng{ 3, 0 };
+        std::vector<uint8_t> random(150000);
+        for (uint8_t& byte : random) {
+            byte = static_cast<uint8_t>(rng.next_uint());
+        }
+        std::copy_n(random.begin() + 20000, 3000, random.begin() + 20000 + 32768);
+        std::copy_n(random.begin() + 70000, 3000, random.begin() + 70000 + 40000);
+
+        for (size_t piece : { size_t{ 997 }, size_t{ 10007 }, random.size() }) {
+            INFO("piece size " << piece);
+            uint32_t max_dist{ 0 };
+            REQUIRE(inflate(deflate(random, piece), max_dist) == random);
+            REQUIRE(max_dist == 32768);
+        }
+    }
+}
+
+TEST_CASE("PNG writer") {
+    const uint32_t w = 37;
+    const uint32_t h = 21;
+    Framebuffer framebuffer{ w, h, 8 };
+    const std::string path = "pngwriter_test.png";
+
+    SECTION("rows reported out of order complete the file") {
+        {
+            PngWriter png{ framebuffer, path };
+            for (uint32_t idx = framebuffer.num_tiles(); idx-- > 0;) {
+                png.tile_final(framebuffer.tile(idx));
+            }
+            REQUIRE(png.finish());
+        }
+
+        auto data = read_file(path);
+        REQUIRE(data.size() > 8 + 25 + 12);
+        REQUIRE(data[0] == 0x89);
+        REQUIRE(std::string(data.begin() + 1, data.begin() + 4) == "PNG");
+        REQUIRE(std::string(data.begin() + 12, data.begin() + 16) == "IHDR");
+        REQUIRE(be32(data, 16) == w);
+        REQUIRE(be32(data, 20) == h);
+        REQUIRE(std::string(data.end() - 8, data.end() - 4) == "IEND");
+        std::filesystem::remove(path);
+    }
+
+    SECTION("aborted writes leave no file") {
+        {
+            PngWriter png{ framebuffer, path };
+            png.tile_final(framebuffer.tile(0));
+            png.abort();
+        }
+
+        REQUIRE_FALSE(std::filesystem::exists(path));
+    }
+}
\ No newline at end of file
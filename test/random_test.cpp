@@ -2,6 +2,8 @@
 
 #include <catch2/catch_all.hpp>
 #include <iostream>
+#include <vector>
+#include <thread>
 
 #include "random.h"
 
@@ -44,4 +46,90 @@ BENCHMARK("random_float(min, max), mt19997") {
         x  = RandomUtils::random_int(i,i + 10,true);
     }
 };
+}
+
+TEST_CASE("Pcg32 streams") {
+uint32_t samples = 100000;
+
+SECTION("the same key gives the same stream") {
+    auto a = RandomUtils::sample_rng(12, 34, 5, 1);
+    auto b = RandomUtils::sample_rng(12, 34, 5, 1);
+    auto c = RandomUtils::sample_rng(12, 34, 5, 2);
+    bool all_equal_c{ true };
+    for (uint32_t i = 0; i < 64; ++i) {
+        uint32_t x = a.next_uint();
+        REQUIRE(x == b.next_uint());
+        all_equal_c &= x == c.next_uint();
+    }
+    REQUIRE(!all_equal_c);
+}
+
+SECTION("streams do not depend on the generating thread") {
+    auto draw = [](uint32_t pixel) {
+        auto rng = RandomUtils::sample_rng(pixel, 7, 3);
+        return rng.next_float();
+    };
+
+    std::vector<float> serial(1024);
+    for (uint32_t p = 0; p < serial.size(); ++p) {
+        serial[p] = draw(p);
+    }
+
+    const uint32_t n_threads = 4;
+    std::vector<float> parallel(serial.size());
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint32_t p = t; p < parallel.size(); p += n_threads) {
+                parallel[p] = draw(p);
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    REQUIRE(parallel == serial);
+}
+
+SECTION("floats are uniform in [0, 1)") {
+    auto rng = RandomUtils::sample_rng(0, 0, 0);
+    uint32_t bins[10]{};
+    for (uint32_t i = 0; i < samples; ++i) {
+        float x = rng.next_float();
+        REQUIRE(x >= 0.f);
+        REQUIRE(x < 1.f);
+        ++bins[static_cast<uint32_t>(x * 10)];
+    }
+
+    for (auto b : bins) {
+        REQUIRE(b > 0.95f * samples / 10);
+        REQUIRE(b < 1.05f * samples / 10);
+    }
+}
+
+BENCHMARK("Pcg32::next_float()") {
+    auto rng = RandomUtils::sample_rng(1, 2, 3);
+    float x;
+    for(uint32_t i = 0; i < samples; ++i) {
+        x = rng.next_float();
+    }
+    return x;
+};
+BENCHMARK("sample_rng() + 2 floats, one stream per sample") {
+    float x;
+    for(uint32_t i = 0; i < samples; ++i) {
+        auto rng = RandomUtils::sample_rng(i & 1023, i >> 10, 0);
+        x = rng.next_float() + rng.next_float();
+    }
+    return x;
+};
+BENCHMARK("random_float(), thread local mt19937") {
+    float x;
+    for(uint32_t i = 0; i < samples; ++i) {
+        x = RandomUtils::random_float(true);
+    }
+    return x;
+};
 }
\ No newline at end of file
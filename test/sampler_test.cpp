@@ -0,0 +1,216 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "sampler.h"
+
+static float mean_sq_error(SamplerType type, uint32_t spp) {
+    /**
+     * @brief: squared error of the per pixel estimates of the integral of
+     * a smooth function over the pixel and a second (path) dimension,
+     * averaged over many pixels
+     */
+    auto f = [](float x, float y, float z) { return std::sin(3.f * x) * y + z * z; };
+    const float exact = (1.f - std::cos(3.f)) / 6.f + 1.f / 3.f;
+
+    Sampler sampler{ type };
+    double sq_err{ 0 };
+    const uint32_t pixels = 32;
+    for (uint32_t j = 0; j < pixels; ++j) {
+        for (uint32_t i = 0; i < pixels; ++i) {
+            double sum{ 0 };
+            for (uint32_t s = 0; s < spp; ++s) {
+                sampler.start(i, j, s);
+                sample_2d_t p = sampler.get_2d();
+                float z = sampler.get_1d();
+                sum += f(p.x, p.y, z);
+            }
+
+            double err = sum / spp - exact;
+            sq_err += err * err;
+        }
+    }
+
+    return static_cast<float>(sq_err / (pixels * pixels));
+}
+
+TEST_CASE("Owen scrambled Sobol") {
+    SECTION("the first 2^k points are a (0, k, 2)-net") {
+        const uint32_t k = 6;
+        const uint32_t n = 1u << k;
+        for (uint64_t seed : { 0ull, 1ull, 0xdeadbeefcafef00dull }) {
+            std::vector<sample_2d_t> pts;
+            for (uint32_t i = 0; i < n; ++i) {
+                pts.push_back(Sobol::owen_2d(i, seed));
+            }
+
+            // every elementary interval of area 1 / n holds exactly one point
+            for (uint32_t a = 0; a <= k; ++a) {
+                uint32_t nx = 1u << a;
+                uint32_t ny = n / nx;
+                std::vector<uint32_t> count(n, 0);
+                for (const auto& p : pts) {
+                    REQUIRE(p.x >= 0.f);
+                    REQUIRE(p.x < 1.f);
+                    REQUIRE(p.y >= 0.f);
+                    REQUIRE(p.y < 1.f);
+                    uint32_t cx = static_cast<uint32_t>(p.x * nx);
+                    uint32_t cy = static_cast<uint32_t>(p.y * ny);
+                    ++count[cy * nx + cx];
+                }
+
+                REQUIRE(std::all_of(count.begin(), count.end(), [](uint32_t c) { return c == 1; }));
+            }
+        }
+    }
+
+    SECTION("unscrambled dimensions match the Sobol direction numbers") {
+        const uint32_t dim1[] = { 0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u };
+        for (uint32_t b = 0; b < 5; ++b) {
+            REQUIRE(Sobol::sobol(1u << b, 0) == 0x80000000u >> b);
+            REQUIRE(Sobol::sobol(1u << b, 1) == dim1[b]);
+        }
+        REQUIRE(Sobol::sobol(3, 1) == (dim1[0] ^ dim1[1]));
+    }
+}
+
+TEST_CASE("Samplers") {
+    for (auto type : { SamplerType::independent, SamplerType::sobol, SamplerType::blue_noise }) {
+        Sampler a{ type };
+        Sampler b{ type };
+
+        // any number of samples, not only perfect squares
+        const uint32_t spp = 10;
+        std::vector<float> xs;
+        for (uint32_t s = 0; s < spp; ++s) {
+            a.start(7, 3, s);
+            b.start(7, 3, s);
+            for (uint32_t d = 0; d < 8; ++d) {
+                sample_2d_t pa = a.get_2d();
+                sample_2d_t pb = b.get_2d();
+                REQUIRE(pa.x == pb.x);
+                REQUIRE(pa.y == pb.y);
+                REQUIRE(pa.x >= 0.f);
+                REQUIRE(pa.x < 1.f);
+                REQUIRE(pa.y >= 0.f);
+                REQUIRE(pa.y < 1.f);
+                if (d == 0) {
+                    xs.push_back(pa.x);
+                }
+            }
+        }
+
+        std::sort(xs.begin(), xs.end());
+        REQUIRE(std::adjacent_find(xs.begin(), xs.end()) == xs.end());
+    }
+
+    SECTION("low discrepancy samples converge faster") {
+        for (uint32_t spp : { 16u, 64u }) {
+            float independent = mean_sq_error(SamplerType::independent, spp);
+            float sobol = mean_sq_error(SamplerType::sobol, spp);
+            float blue_noise = mean_sq_error(SamplerType::blue_noise, spp);
+            REQUIRE(sobol < 0.5f * independent);
+            REQUIRE(blue_noise < 0.5f * independent);
+        }
+    }
+}
+
+TEST_CASE("Cosine weighted hemisphere") {
+    Sampler sampler{ SamplerType::independent };
+    for (const Vec3f& n : { Vec3f(0.f, 0.f, 1.f), Vec3f(0.f, 0.f, -1.f), unit_vector(Vec3f(0.3f, -0.8f, 0.2f)) }) {
+        Vec3f t, b;
+        Warp::orthonormal_basis(n, t, b);
+        REQUIRE_THAT(dot(t, n), Catch::Matchers::WithinAbs(0.f, 1e-6f));
+        REQUIRE_THAT(dot(b, n), Catch::Matchers::WithinAbs(0.f, 1e-6f));
+        REQUIRE_THAT(dot(t, b), Catch::Matchers::WithinAbs(0.f, 1e-6f));
+        REQUIRE_THAT(t.length(), Catch::Matchers::WithinAbs(1.f, 1e-6f));
+
+        // E[cos] = 2 / 3 under the pdf cos / pi
+        const uint32_t n_samples = 1 << 14;
+        double sum_cos{ 0 };
+        for (uint32_t s = 0; s < n_samples; ++s) {
+            sampler.start(0, 0, s);
+            Vec3f d = Warp::cosine_hemisphere(n, sampler.get_2d());
+            REQUIRE_THAT(d.length(), Catch::Matchers::WithinAbs(1.f, 1e-5f));
+            REQUIRE(dot(d, n) >= 0.f);
+            sum_cos += dot(d, n);
+        }
+
+        REQUIRE_THAT(sum_cos / n_samples, Catch::Matchers::WithinAbs(2.0 / 3.0, 0.01));
+    }
+}
+
+TEST_CASE("Alias table") {
+    SECTION("indices are drawn proportional to their weight") {
+        const std::vector<float> weights{ 1.f, 0.f, 3.f, 0.5f, 10.f, 0.25f };
+        AliasTable table{ weights };
+        float total{ 0.f };
+        for (float w : weights) {
+            total += w;
+        }
+
+        const uint32_t n = 1 << 16;
+        std::vector<uint32_t> counts(weights.size(), 0);
+        for (uint32_t k = 0; k < n; ++k) {
+            ++counts[table.sample((k + 0.5f) / n)];
+        }
+
+        for (uint32_t idx = 0; idx < weights.size(); ++idx) {
+            REQUIRE_THAT(table.pdf(idx), Catch::Matchers::WithinAbs(weights[idx] / total, 1e-6f));
+            REQUIRE_THAT(static_cast<float>(counts[idx]) / n, Catch::Matchers::WithinAbs(weights[idx] / total, 1e-3f));
+        }
+        REQUIRE(counts[1] == 0);
+    }
+
+    SECTION("all zero weights fall back to uniform") {
+        AliasTable table{ std::vector<float>(4, 0.f) };
+        for (uint32_t idx = 0; idx < 4; ++idx) {
+            REQUIRE(table.pdf(idx) == 0.25f);
+            REQUIRE(table.sample((idx + 0.5f) / 4) == idx);
+        }
+    }
+}
+
+TEST_CASE("Blue noise mask") {
+    const auto& mask = BlueNoise::mask();
+    const uint32_t size = BlueNoise::mask_size;
+    REQUIRE(mask.size() == size * size);
+
+    SECTION("every threshold appears once") {
+        std::vector<float> sorted = mask;
+        std::sort(sorted.begin(), sorted.end());
+        for (uint32_t k = 0; k < sorted.size(); ++k) {
+            REQUIRE_THAT(sorted[k], Catch::Matchers::WithinAbs((k + 0.5f) / sorted.size(), 1e-6f));
+        }
+    }
+
+    SECTION("low frequencies are suppressed") {
+        // averages over k x k blocks of white noise have variance 1 / (12 k^2),
+        // blue noise has little energy at those low frequencies
+        const uint32_t k = 4;
+        std::vector<double> means;
+        for (uint32_t by = 0; by < size; by += k) {
+            for (uint32_t bx = 0; bx < size; bx += k) {
+                double sum{ 0 };
+                for (uint32_t y = by; y < by + k; ++y) {
+                    for (uint32_t x = bx; x < bx + k; ++x) {
+                        sum += mask[y * size + x];
+                    }
+                }
+                means.push_back(sum / (k * k));
+            }
+        }
+
+        double var{ 0 };
+        for (double m : means) {
+            var += (m - 0.5) * (m - 0.5);
+        }
+        var /= means.size();
+
+        REQUIRE(var < 0.25 / (12.0 * k * k));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "tonemap.h"
+#include "random.h"
+
+static uint32_t channel(uint32_t pixel, uint32_t shift) {
+    return (pixel >> shift) & 0xff;
+}
+
+TEST_CASE("Tonemapper") {
+    const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails(SDL_PIXELFORMAT_RGBA32);
+
+    SECTION("the simd pass matches the scalar one") {
+        // 1 pixel off at most, the compiler may fuse the scalar multiply adds
+        const uint32_t n = 203; // not a multiple of any simd width
+        alignas(Tonemapper::span_alignment) static float rgb[3][256]{};
+        RandomUtils::Pcg32 rng{ 7, 1 };
+        for (auto& c : rgb) {
+            for (uint32_t k = 0; k < n; ++k) {
+                c[k] = 4.f * rng.next_float() - 0.5f; // negative and above 1 too
+            }
+        }
+        rgb[0][3] = std::numeric_limits<float>::quiet_NaN();
+        rgb[1][5] = std::numeric_limits<float>::infinity();
+
+        for (auto tonemap : { TonemapType::none, TonemapType::reinhard, TonemapType::aces }) {
+            for (bool gamma : { true, false }) {
+                Tonemapper tm{ SDL_PIXELFORMAT_RGBA32, tonemap, gamma };
+                std::vector<uint32_t> out(n + 1, 0xdeadbeefu);
+                tm.pack(rgb[0], rgb[1], rgb[2], n, out.data());
+                REQUIRE(out[n] == 0xdeadbeefu); // nothing written past n
+
+                for (uint32_t k = 0; k < n; ++k) {
+                    uint32_t ref = tm.pack(Color(rgb[0][k], rgb[1][k], rgb[2][k]));
+                    REQUIRE(channel(out[k], details->Ashift) == 0xff);
+                    for (uint32_t shift : { details->Rshift, details->Gshift, details->Bshift }) {
+                        int diff = static_cast<int>(channel(out[k], shift)) - static_cast<int>(channel(ref, shift));
+                        REQUIRE(std::abs(diff) <= 1);
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("without a curve the output is the clamped gamma 2 color") {
+        Tonemapper tm{ SDL_PIXELFORMAT_RGBA32, TonemapType::none };
+        uint32_t p = tm.pack(Color(0.25f, 2.f, -1.f));
+        REQUIRE(channel(p, details->Rshift) == static_cast<uint32_t>(0.5f * 255.f));
+        REQUIRE(channel(p, details->Gshift) == 254);
+        REQUIRE(channel(p, details->Bshift) == 0);
+    }
+
+    SECTION("the curves keep highlights below white and are monotonic") {
+        for (auto tonemap : { TonemapType::reinhard, TonemapType::aces }) {
+            Tonemapper tm{ SDL_PIXELFORMAT_RGBA32, tonemap, false };
+            uint32_t last{ 0 };
+            for (float x = 0.f; x < 4.f; x += 0.01f) {
+                uint32_t v = channel(tm.pack(Color(x, x, x)), details->Rshift);
+                REQUIRE(v >= last);
+                last = v;
+            }
+            REQUIRE(last < 254);
+            REQUIRE(channel(tm.pack(Color(1.f, 1.f, 1.f)), details->Rshift) < 254);
+        }
+    }
+}
\ No newline at end of file